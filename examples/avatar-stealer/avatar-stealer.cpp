@@ -1,32 +1,63 @@
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <hexicord/gateway_client.hpp>
 #include <hexicord/rest_client.hpp>
+#include <hexicord/cdn_client.hpp>
 
 boost::asio::io_service ioService;
+std::unique_ptr<Hexicord::CdnClient> cdnClient;
 
-void stealUserAvatar(const nlohmann::json& userObject) {
-    std::string dbgJson = userObject.dump(4); 
+struct AvatarDownload {
+    std::string path;     // CDN path.
+    std::string filename; // where to save.
+};
 
+AvatarDownload userAvatar(const Hexicord::GatewayJson& userObject) {
     if (userObject["avatar"].is_null()) {
-        Hexicord::ImageReference<Hexicord::DefaultUserAvatar>(std::stoi(userObject["discriminator"].get<std::string>()))
-            .download<Hexicord::Png>(ioService, 2048)
-            .file.write(std::string("user_") + userObject["id"].get<std::string>() +
-                        "_default.png");
+        return {
+            Hexicord::ImageReference<Hexicord::DefaultUserAvatar>(std::stoi(userObject["discriminator"].get<std::string>()))
+                .url<Hexicord::Png>(2048),
+            std::string("user_") + userObject["id"].get<std::string>() + "_default.png"
+        };
     } else {
-        Hexicord::ImageReference<Hexicord::UserAvatar>(Hexicord::Snowflake(userObject["id"].get<std::string>()), userObject["avatar"])
-            .download<Hexicord::Png>(ioService, 2048)
-            .file.write(std::string("user_") + userObject["id"].get<std::string>() +
-                        "_" + userObject["avatar"].get<std::string>() + ".png");
+        return {
+            Hexicord::ImageReference<Hexicord::UserAvatar>(Hexicord::Snowflake(userObject["id"].get<std::string>()), userObject["avatar"])
+                .url<Hexicord::Png>(2048),
+            std::string("user_") + userObject["id"].get<std::string>() +
+                "_" + userObject["avatar"].get<std::string>() + ".png"
+        };
     }
 }
 
-void stealGuildAvatar(const nlohmann::json& guildObject) {
-    std::string dbgJson = guildObject.dump(4); 
-    Hexicord::ImageReference<Hexicord::GuildIcon>(Hexicord::Snowflake(guildObject["id"].get<std::string>()), guildObject["icon"])
-        .download<Hexicord::Png>(ioService, 2048)
-        .file.write(std::string("guild_") + guildObject["id"].get<std::string>() +
-                    "_" + guildObject["icon"].get<std::string>() + ".png");
+AvatarDownload guildAvatar(const Hexicord::GatewayJson& guildObject) {
+    return {
+        Hexicord::ImageReference<Hexicord::GuildIcon>(Hexicord::Snowflake(guildObject["id"].get<std::string>()), guildObject["icon"])
+            .url<Hexicord::Png>(2048),
+        std::string("guild_") + guildObject["id"].get<std::string>() +
+            "_" + guildObject["icon"].get<std::string>() + ".png"
+    };
+}
+
+// Download all avatars at once, CdnClient runs them concurrently over
+// pooled connections and skips ones already in cache.
+void stealAvatars(const std::vector<AvatarDownload>& downloads) {
+    std::vector<std::string> paths;
+    for (const auto& download : downloads) paths.push_back(download.path);
+
+    cdnClient->asyncDownloadBatch(paths, [downloads](std::vector<Hexicord::CdnClient::Download> results) {
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (results[i].error) {
+                try {
+                    std::rethrow_exception(results[i].error);
+                } catch (std::exception& excp) {
+                    std::cerr << "Failed to download " << results[i].path << ": " << excp.what() << '\n';
+                }
+                continue;
+            }
+            Hexicord::File(downloads[i].filename, results[i].bytes).write(downloads[i].filename);
+        }
+    });
 }
 
 int main(int argc, char** argv) {
@@ -36,19 +67,23 @@ int main(int argc, char** argv) {
                   << "E.g. env BOT_TOKEN=token_here " << argv[0] << '\n';
         return 1;
     }
+    const char* cacheDirectory = std::getenv("CDN_CACHE");
 
     Hexicord::GatewayClient gclient(ioService, botToken);
     Hexicord::RestClient    rclient(ioService, botToken);
+    cdnClient.reset(new Hexicord::CdnClient(ioService, cacheDirectory ? cacheDirectory : ""));
 
-    gclient.eventDispatcher.addHandler(Hexicord::Event::GuildCreate, [](const nlohmann::json& payload) {
-        stealGuildAvatar(payload);
-        for (const nlohmann::json& member : payload["members"]) {
-            stealUserAvatar(member["user"]);
+    gclient.eventDispatcher.addHandler(Hexicord::Event::GuildCreate, [](const Hexicord::GatewayJson& payload) {
+        std::vector<AvatarDownload> downloads;
+        if (!payload["icon"].is_null()) downloads.push_back(guildAvatar(payload));
+        for (const Hexicord::GatewayJson& member : payload["members"]) {
+            downloads.push_back(userAvatar(member["user"]));
         }
+        stealAvatars(downloads);
     });
 
-    gclient.eventDispatcher.addHandler(Hexicord::Event::GuildMemberAdd, [](const nlohmann::json& payload) {
-        stealUserAvatar(payload["user"]);
+    gclient.eventDispatcher.addHandler(Hexicord::Event::GuildMemberAdd, [](const Hexicord::GatewayJson& payload) {
+        stealAvatars({ userAvatar(payload["user"]) });
     });
 
     gclient.connect(rclient.getGatewayUrlBot().first);
@@ -24,11 +24,11 @@ int main(int argc, char** argv) {
     std::map<Hexicord::Snowflake, bool> switchFlags;;
     nlohmann::json me;
 
-    gclient.eventDispatcher.addHandler(Hexicord::Event::Ready, [&me](const nlohmann::json& json) {
-        me = json["user"];
+    gclient.eventDispatcher.addHandler(Hexicord::Event::Ready, [&me](const Hexicord::GatewayJson& json) {
+        me = Hexicord::toJson(json["user"]);
     });
 
-    gclient.eventDispatcher.addHandler(Hexicord::Event::MessageCreate, [&](const nlohmann::json& json) {
+    gclient.eventDispatcher.addHandler(Hexicord::Event::MessageCreate, [&](const Hexicord::GatewayJson& json) {
         Hexicord::Snowflake messageId(json["id"].get<std::string>());
         Hexicord::Snowflake channelId(json["channel_id"].get<std::string>());
 
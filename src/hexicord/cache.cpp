@@ -0,0 +1,458 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/cache.hpp>
+#include <hexicord/internal/utils.hpp>
+
+#include <algorithm>
+
+namespace Hexicord {
+
+namespace {
+    // IDs are strings in JSON, but may be numbers in ETF.
+    Snowflake toSnowflake(const GatewayJson& value) {
+        if (value.is_string()) return Snowflake(value.get_ref<const std::string&>());
+        if (value.is_number()) return Snowflake(value.get<uint64_t>());
+        return Snowflake();
+    }
+
+    Snowflake snowflakeField(const GatewayJson& object, const char* key) {
+        auto it = object.find(key);
+        return it != object.end() ? toSnowflake(*it) : Snowflake();
+    }
+
+    // operator[] of const object can't be used for keys which may be missing.
+    const GatewayJson& field(const GatewayJson& object, const char* key) {
+        static const GatewayJson null;
+        auto it = object.find(key);
+        return it != object.end() ? *it : null;
+    }
+
+    std::string stringField(const GatewayJson& object, const char* key) {
+        auto it = object.find(key);
+        return it != object.end() && it->is_string() ? it->get<std::string>() : std::string();
+    }
+
+    template<typename T>
+    T valueField(const GatewayJson& object, const char* key, T defaultValue) {
+        auto it = object.find(key);
+        return it != object.end() && !it->is_null() ? it->get<T>() : defaultValue;
+    }
+
+    std::vector<Snowflake> snowflakeArray(const GatewayJson& object, const char* key) {
+        std::vector<Snowflake> result;
+
+        auto it = object.find(key);
+        if (it == object.end() || !it->is_array()) return result;
+
+        result.reserve(it->size());
+        for (const auto& element : *it) {
+            result.push_back(toSnowflake(element));
+        }
+        return result;
+    }
+
+    void addUnique(std::vector<Snowflake>& ids, Snowflake id) {
+        if (std::find(ids.begin(), ids.end(), id) == ids.end()) ids.push_back(id);
+    }
+
+    void removeId(std::vector<Snowflake>& ids, Snowflake id) {
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+    }
+
+    // Partial user objects (e.g. in GuildMemberUpdate) contain only some fields.
+    void updateUser(CachedUser& user, const GatewayJson& object) {
+        user.id = snowflakeField(object, "id");
+
+        if (object.count("username")) user.username = stringField(object, "username");
+        if (object.count("avatar"))   user.avatar   = stringField(object, "avatar");
+        if (object.count("bot"))      user.bot      = valueField(object, "bot", false);
+        std::string discriminator = stringField(object, "discriminator");
+        if (!discriminator.empty()) user.discriminator = uint16_t(std::stoul(discriminator));
+    }
+
+    template<typename Map, typename Key>
+    auto findOptional(const Map& map, const Key& key) -> boost::optional<typename Map::mapped_type> {
+        auto it = map.find(key);
+        if (it == map.end()) return boost::none;
+        return it->second;
+    }
+} // anonymous namespace
+
+void Cache::attach(EventDispatcher& dispatcher) {
+    using namespace std::placeholders;
+
+    dispatcher.addHandler(Event::Ready,             std::bind(&Cache::onReady,         this, _1));
+    dispatcher.addHandler(Event::GuildCreate,       std::bind(&Cache::onGuildCreate,   this, _1));
+    dispatcher.addHandler(Event::GuildUpdate,       std::bind(&Cache::onGuildUpdate,   this, _1));
+    dispatcher.addHandler(Event::GuildDelete,       std::bind(&Cache::onGuildDelete,   this, _1));
+    dispatcher.addHandler(Event::ChannelCreate,     std::bind(&Cache::onChannelCreate, this, _1));
+    dispatcher.addHandler(Event::ChannelUpdate,     std::bind(&Cache::onChannelCreate, this, _1));
+    dispatcher.addHandler(Event::ChannelDelete,     std::bind(&Cache::onChannelDelete, this, _1));
+    dispatcher.addHandler(Event::GuildRoleCreate,   std::bind(&Cache::onRoleCreate,    this, _1));
+    dispatcher.addHandler(Event::GuildRoleUpdate,   std::bind(&Cache::onRoleCreate,    this, _1));
+    dispatcher.addHandler(Event::GuildRoleDelete,   std::bind(&Cache::onRoleDelete,    this, _1));
+    dispatcher.addHandler(Event::GuildMemberAdd,    std::bind(&Cache::onMemberAdd,     this, _1));
+    dispatcher.addHandler(Event::GuildMemberUpdate, std::bind(&Cache::onMemberUpdate,  this, _1));
+    dispatcher.addHandler(Event::GuildMemberRemove, std::bind(&Cache::onMemberRemove,  this, _1));
+    dispatcher.addHandler(Event::GuildMembersChunk, std::bind(&Cache::onMembersChunk,  this, _1));
+    dispatcher.addHandler(Event::UserUpdate,        std::bind(&Cache::onUserUpdate,    this, _1));
+}
+
+boost::optional<CachedGuild> Cache::guild(Snowflake id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOptional(guilds, id);
+}
+
+boost::optional<CachedChannel> Cache::channel(Snowflake id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOptional(channels, id);
+}
+
+boost::optional<CachedRole> Cache::role(Snowflake id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOptional(roles, id);
+}
+
+boost::optional<CachedMember> Cache::member(Snowflake guildId, Snowflake userId) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto guildMembers = members.find(guildId);
+    if (guildMembers == members.end()) return boost::none;
+
+    auto result = guildMembers->second.get(userId);
+    if (result) result->guildId = guildId;
+    return result;
+}
+
+boost::optional<CachedUser> Cache::user(Snowflake id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (selfUser && selfUser->id == id) return selfUser;
+
+    // Users of members are kept only in member stores.
+    for (const auto& pair : members) {
+        auto result = pair.second.getUser(id);
+        if (result) return result;
+    }
+    return boost::none;
+}
+
+boost::optional<CachedUser> Cache::self() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return selfUser;
+}
+
+std::vector<Snowflake> Cache::guildIds() const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<Snowflake> result;
+    result.reserve(guilds.size());
+    for (const auto& pair : guilds) {
+        result.push_back(pair.first);
+    }
+    return result;
+}
+
+void Cache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    selfUser = boost::none;
+    guilds.clear();
+    channels.clear();
+    roles.clear();
+    members.clear();
+}
+
+void Cache::onReady(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const GatewayJson& userObject = field(payload, "user");
+    if (userObject.is_object()) {
+        selfUser = CachedUser();
+        updateUser(*selfUser, userObject);
+    }
+
+    // Only IDs are known now, GuildCreate will follow for each guild.
+    for (const auto& guildObject : field(payload, "guilds")) {
+        Snowflake id = snowflakeField(guildObject, "id");
+        CachedGuild& guild = guilds[id];
+        guild.id = id;
+        guild.unavailable = true;
+    }
+
+    auto privateChannels = payload.find("private_channels");
+    if (privateChannels != payload.end()) {
+        for (const auto& channelObject : *privateChannels) {
+            storeChannel(channelObject, Snowflake());
+        }
+    }
+}
+
+void Cache::onGuildCreate(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Snowflake id = snowflakeField(payload, "id");
+    if (valueField(payload, "unavailable", false)) {
+        guilds[id].id = id;
+        guilds[id].unavailable = true;
+        return;
+    }
+
+    CachedGuild& guild = guilds[id];
+    storeGuildInfo(guild, payload);
+    guild.memberCount = valueField(payload, "member_count", 0u);
+    guild.unavailable = false;
+
+    // Channels deleted while guild was unavailable are not in new list.
+    for (Snowflake channelId : guild.channels) {
+        channels.erase(channelId);
+    }
+    guild.channels.clear();
+    // Channels in GuildCreate don't have guild_id.
+    for (const auto& channelObject : field(payload, "channels")) {
+        storeChannel(channelObject, id);
+    }
+
+    auto membersArray = payload.find("members");
+    if (membersArray != payload.end()) {
+        members[id].reserve(membersArray->size());
+        for (const auto& memberObject : *membersArray) {
+            storeMember(memberObject, id);
+        }
+    }
+}
+
+void Cache::onGuildUpdate(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Snowflake id = snowflakeField(payload, "id");
+    storeGuildInfo(guilds[id], payload);
+}
+
+void Cache::onGuildDelete(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Snowflake id = snowflakeField(payload, "id");
+    if (valueField(payload, "unavailable", false)) {
+        // Outage, guild will be back with GuildCreate.
+        auto it = guilds.find(id);
+        if (it != guilds.end()) it->second.unavailable = true;
+        return;
+    }
+    removeGuild(id);
+}
+
+void Cache::onChannelCreate(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+    storeChannel(payload, snowflakeField(payload, "guild_id"));
+}
+
+void Cache::onChannelDelete(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Snowflake id      = snowflakeField(payload, "id");
+    Snowflake guildId = snowflakeField(payload, "guild_id");
+
+    channels.erase(id);
+    auto guild = guilds.find(guildId);
+    if (guild != guilds.end()) removeId(guild->second.channels, id);
+}
+
+void Cache::onRoleCreate(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const GatewayJson& roleObject = field(payload, "role");
+    if (roleObject.is_object()) storeRole(roleObject, snowflakeField(payload, "guild_id"));
+}
+
+void Cache::onRoleDelete(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Snowflake id      = snowflakeField(payload, "role_id");
+    Snowflake guildId = snowflakeField(payload, "guild_id");
+
+    roles.erase(id);
+    auto guild = guilds.find(guildId);
+    if (guild != guilds.end()) removeId(guild->second.roles, id);
+
+    auto guildMembers = members.find(guildId);
+    if (guildMembers != members.end()) guildMembers->second.removeRole(id);
+}
+
+void Cache::onMemberAdd(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Snowflake guildId = snowflakeField(payload, "guild_id");
+    storeMember(payload, guildId);
+
+    auto guild = guilds.find(guildId);
+    if (guild != guilds.end()) ++guild->second.memberCount;
+}
+
+void Cache::onMemberUpdate(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Update contains only user, roles and nick, other fields are kept.
+    storeMember(payload, snowflakeField(payload, "guild_id"));
+}
+
+void Cache::onMemberRemove(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Snowflake guildId = snowflakeField(payload, "guild_id");
+    Snowflake userId  = snowflakeField(field(payload, "user"), "id");
+
+    auto guildMembers = members.find(guildId);
+    if (guildMembers != members.end()) guildMembers->second.erase(userId);
+
+    auto guild = guilds.find(guildId);
+    if (guild != guilds.end() && guild->second.memberCount != 0) --guild->second.memberCount;
+}
+
+void Cache::onMembersChunk(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Snowflake guildId = snowflakeField(payload, "guild_id");
+    for (const auto& memberObject : field(payload, "members")) {
+        storeMember(memberObject, guildId);
+    }
+}
+
+void Cache::onUserUpdate(const GatewayJson& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Sent only for current user.
+    if (!selfUser) selfUser = CachedUser();
+    updateUser(*selfUser, payload);
+
+    for (auto& pair : members) {
+        pair.second.setUser(*selfUser);
+    }
+}
+
+void Cache::storeGuildInfo(CachedGuild& guild, const GatewayJson& object) {
+    guild.id      = snowflakeField(object, "id");
+    guild.ownerId = snowflakeField(object, "owner_id");
+    guild.name    = stringField(object, "name");
+    guild.icon    = stringField(object, "icon");
+
+    auto rolesArray = object.find("roles");
+    if (rolesArray == object.end()) return;
+
+    for (Snowflake roleId : guild.roles) {
+        roles.erase(roleId);
+    }
+    guild.roles.clear();
+    for (const auto& roleObject : *rolesArray) {
+        storeRole(roleObject, guild.id);
+    }
+}
+
+void Cache::storeChannel(const GatewayJson& object, Snowflake guildId) {
+    Snowflake id = snowflakeField(object, "id");
+
+    CachedChannel& channel = channels[id];
+    channel.id       = id;
+    channel.guildId  = guildId;
+    channel.parentId = snowflakeField(object, "parent_id");
+    channel.name     = stringField(object, "name");
+    channel.type     = valueField(object, "type", 0);
+    channel.position = valueField(object, "position", 0);
+
+    channel.overwrites.clear();
+    auto overwrites = object.find("permission_overwrites");
+    if (overwrites != object.end()) {
+        channel.overwrites.reserve(overwrites->size());
+        for (const auto& overwriteObject : *overwrites) {
+            PermissionOverwrite overwrite;
+            overwrite.id    = snowflakeField(overwriteObject, "id");
+            overwrite.type  = stringField(overwriteObject, "type") == "member" ? PermissionOverwrite::Member
+                                                                              : PermissionOverwrite::Role;
+            overwrite.allow = Permissions(valueField<uint64_t>(overwriteObject, "allow", 0));
+            overwrite.deny  = Permissions(valueField<uint64_t>(overwriteObject, "deny", 0));
+            channel.overwrites.push_back(overwrite);
+        }
+    }
+
+    if (guildId != 0) {
+        auto guild = guilds.find(guildId);
+        if (guild != guilds.end()) addUnique(guild->second.channels, id);
+    }
+}
+
+void Cache::storeRole(const GatewayJson& object, Snowflake guildId) {
+    Snowflake id = snowflakeField(object, "id");
+
+    CachedRole& role = roles[id];
+    role.id          = id;
+    role.guildId     = guildId;
+    role.name        = stringField(object, "name");
+    role.permissions = Permissions(valueField<uint64_t>(object, "permissions", 0));
+    role.color       = valueField<uint32_t>(object, "color", 0);
+    role.position    = valueField(object, "position", 0);
+    role.hoist       = valueField(object, "hoist", false);
+    role.managed     = valueField(object, "managed", false);
+    role.mentionable = valueField(object, "mentionable", false);
+
+    auto guild = guilds.find(guildId);
+    if (guild != guilds.end()) addUnique(guild->second.roles, id);
+}
+
+void Cache::storeMember(const GatewayJson& object, Snowflake guildId) {
+    const GatewayJson& userObject = field(object, "user");
+    if (!userObject.is_object()) return;
+
+    Snowflake userId = snowflakeField(userObject, "id");
+
+    MemberStore& store = members[guildId];
+
+    // Missing fields (joined_at, deaf, mute in GuildMemberUpdate) are kept.
+    CachedMember member = store.get(userId).value_or(CachedMember());
+    member.userId = userId;
+    member.nick   = stringField(object, "nick");
+    member.roles  = snowflakeArray(object, "roles");
+
+    if (object.count("joined_at")) member.joinedAt = uint32_t(Utils::parseIso8601(stringField(object, "joined_at")));
+    if (object.count("deaf"))      member.deaf     = valueField(object, "deaf", false);
+    if (object.count("mute"))      member.mute     = valueField(object, "mute", false);
+
+    store.set(member);
+
+    CachedUser user = store.getUser(userId).value_or(CachedUser());
+    updateUser(user, userObject);
+    store.setUser(user);
+}
+
+void Cache::removeGuild(Snowflake id) {
+    auto it = guilds.find(id);
+    if (it == guilds.end()) return;
+
+    for (Snowflake roleId : it->second.roles) {
+        roles.erase(roleId);
+    }
+    for (Snowflake channelId : it->second.channels) {
+        channels.erase(channelId);
+    }
+    members.erase(id);
+    guilds.erase(it);
+}
+
+} // namespace Hexicord
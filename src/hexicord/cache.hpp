@@ -0,0 +1,162 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_CACHE_HPP
+#define HEXICORD_CACHE_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include <hexicord/event_dispatcher.hpp>
+#include <hexicord/gateway_json.hpp>
+#include <hexicord/member_store.hpp>
+#include <hexicord/permission.hpp>
+#include <hexicord/snowflake_map.hpp>
+#include <hexicord/types/snowflake.hpp>
+
+/**
+ *  \file cache.hpp
+ *
+ *  In-memory cache of guilds, channels, roles, members and users
+ *  maintained using gateway events.
+ */
+
+namespace Hexicord {
+    struct CachedRole {
+        Snowflake id;
+        Snowflake guildId;
+        std::string name;
+        Permissions permissions = Permissions(0);
+        uint32_t color = 0;
+        int position = 0;
+        bool hoist = false, managed = false, mentionable = false;
+    };
+
+    struct PermissionOverwrite {
+        enum Type : uint8_t {
+            Role,
+            Member
+        };
+
+        Snowflake id;
+        Type type = Role;
+        Permissions allow = Permissions(0), deny = Permissions(0);
+    };
+
+    struct CachedChannel {
+        Snowflake id;
+        Snowflake guildId;  ///< 0 for DM channels.
+        Snowflake parentId; ///< Category, 0 if none.
+        std::string name;
+        int type = 0;
+        int position = 0;
+        std::vector<PermissionOverwrite> overwrites;
+    };
+
+    struct CachedGuild {
+        Snowflake id;
+        Snowflake ownerId;
+        std::string name;
+        std::string icon;
+        std::vector<Snowflake> roles;
+        std::vector<Snowflake> channels;
+        unsigned memberCount = 0;
+        bool unavailable = false; ///< Guild is known from Ready, but GuildCreate not received yet (or outage).
+    };
+
+    /**
+     * Keeps typed records of entities received through gateway,
+     * so they can be looked up without REST requests.
+     *
+     * Usage:
+     * ```cpp
+     * Hexicord::Cache cache;
+     * cache.attach(gclient.eventDispatcher);
+     * // ...
+     * auto channel = cache.channel(channelId);
+     * if (channel) std::cout << channel->name;
+     * ```
+     *
+     * Single cache can be attached to dispatchers of all shards. All methods
+     * are thread-safe, lookups return copies of records. Members are only
+     * known for large guilds after requesting them (see
+     * \ref GatewayClient::requestGuildMembers).
+     *
+     * User records of members are stored in \ref MemberStore of each guild
+     * and dropped with membership, so \ref user looks through all guilds.
+     * Only current user is kept outside of them.
+     */
+    class Cache {
+    public:
+        /**
+         * Add handlers for events used by cache. Cache should outlive dispatcher.
+         */
+        void attach(EventDispatcher& dispatcher);
+
+        boost::optional<CachedGuild>   guild(Snowflake id) const;
+        boost::optional<CachedChannel> channel(Snowflake id) const;
+        boost::optional<CachedRole>    role(Snowflake id) const;
+        boost::optional<CachedMember>  member(Snowflake guildId, Snowflake userId) const;
+        boost::optional<CachedUser>    user(Snowflake id) const;
+
+        /**
+         * Current user (received in Ready event).
+         */
+        boost::optional<CachedUser> self() const;
+
+        std::vector<Snowflake> guildIds() const;
+
+        void clear();
+    private:
+        void onReady(const GatewayJson& payload);
+        void onGuildCreate(const GatewayJson& payload);
+        void onGuildUpdate(const GatewayJson& payload);
+        void onGuildDelete(const GatewayJson& payload);
+        void onChannelCreate(const GatewayJson& payload);
+        void onChannelDelete(const GatewayJson& payload);
+        void onRoleCreate(const GatewayJson& payload);
+        void onRoleDelete(const GatewayJson& payload);
+        void onMemberAdd(const GatewayJson& payload);
+        void onMemberUpdate(const GatewayJson& payload);
+        void onMemberRemove(const GatewayJson& payload);
+        void onMembersChunk(const GatewayJson& payload);
+        void onUserUpdate(const GatewayJson& payload);
+
+        // Following methods expect mutex to be locked.
+        void storeGuildInfo(CachedGuild& guild, const GatewayJson& object);
+        void storeChannel(const GatewayJson& object, Snowflake guildId);
+        void storeRole(const GatewayJson& object, Snowflake guildId);
+        void storeMember(const GatewayJson& object, Snowflake guildId);
+        void removeGuild(Snowflake id);
+
+        mutable std::mutex mutex;
+
+        boost::optional<CachedUser> selfUser;
+        SnowflakeMap<CachedGuild>   guilds;
+        SnowflakeMap<CachedChannel> channels;
+        SnowflakeMap<CachedRole>    roles;
+        SnowflakeMap<MemberStore>   members; // by guild ID
+    };
+}
+
+#endif // HEXICORD_CACHE_HPP
@@ -0,0 +1,204 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/cdn_client.hpp>
+
+#include <cstdio>                      // std::rename, std::remove, std::snprintf
+#include <fstream>                     // std::ifstream, std::ofstream
+#include <memory>                      // std::make_shared
+#include <random>                      // std::random_device
+#include <boost/system/system_error.hpp>
+#include <hexicord/exceptions.hpp>     // LogicError, RuntimeError
+#include <hexicord/types/file.hpp>     // File::map
+
+#if defined(HEXICORD_DEBUG_LOG)
+    #include <iostream>
+    #define DEBUG_MSG(msg) do { std::cerr <<  "cdn_client.cpp:" << __LINE__ << " " << (msg) << '\n'; } while (false)
+#else
+    #define DEBUG_MSG(msg)
+#endif
+
+namespace Hexicord {
+    namespace {
+        std::string toHex(uint64_t value, unsigned digits) {
+            char buffer[17];
+            std::snprintf(buffer, sizeof(buffer), "%0*llx", int(digits), static_cast<unsigned long long>(value));
+            return buffer;
+        }
+    } // anonymous namespace
+
+    CdnClient::CdnClient(boost::asio::io_service& ioService, const std::string& cacheDirectory,
+                         size_t maxConnections)
+        : cacheDirectory(cacheDirectory)
+        , ioService(ioService)
+        , pool(ioService, "cdn.discordapp.com", maxConnections)
+        , tempSuffix(toHex(std::random_device()(), 8))
+        , tempCounter(0) {}
+
+    SharedBuffer CdnClient::download(const std::string& path) {
+        SharedBuffer bytes;
+        if (readCache(path, bytes)) return bytes;
+
+        DEBUG_MSG(std::string("Downloading ") + path);
+        REST::HTTPResponse response = pool.request(buildRequest(path));
+        checkResponse(response);
+
+        bytes = SharedBuffer(std::move(response.body));
+        writeCache(path, bytes);
+        return bytes;
+    }
+
+    void CdnClient::asyncDownload(const std::string& path, DownloadHandler handler) {
+        SharedBuffer bytes;
+        if (readCache(path, bytes)) {
+            ioService.post([handler, bytes]() {
+                handler(nullptr, bytes);
+            });
+            return;
+        }
+
+        DEBUG_MSG(std::string("Downloading ") + path);
+        pool.asyncRequest(buildRequest(path), [this, path, handler](REST::HTTPResponse response,
+                                                                    boost::system::error_code ec) {
+            if (ec) {
+                return handler(std::make_exception_ptr(boost::system::system_error(ec)), {});
+            }
+
+            try {
+                checkResponse(response);
+            } catch (...) {
+                return handler(std::current_exception(), {});
+            }
+
+            SharedBuffer bytes(std::move(response.body));
+            writeCache(path, bytes);
+            handler(nullptr, bytes);
+        });
+    }
+
+    void CdnClient::asyncDownloadBatch(const std::vector<std::string>& paths, BatchHandler handler) {
+        if (paths.empty()) {
+            ioService.post([handler]() {
+                handler({});
+            });
+            return;
+        }
+
+        struct BatchState {
+            std::vector<Download> results;
+            std::atomic<size_t> remaining;
+            BatchHandler handler;
+        };
+        auto state = std::make_shared<BatchState>();
+        state->results.resize(paths.size());
+        state->remaining = paths.size();
+        state->handler   = std::move(handler);
+
+        // Pool limits count of simultaneous requests, rest are queued.
+        for (size_t i = 0; i < paths.size(); ++i) {
+            state->results[i].path = paths[i];
+            asyncDownload(paths[i], [state, i](std::exception_ptr error, SharedBuffer bytes) {
+                state->results[i].error = error;
+                state->results[i].bytes = std::move(bytes);
+
+                // Each download writes only its own slot, last one reports.
+                if (--state->remaining == 0) {
+                    state->handler(std::move(state->results));
+                }
+            });
+        }
+    }
+
+    std::string CdnClient::cacheKey(const std::string& path) {
+        // FNV-1a, stable across platforms and runs (unlike std::hash).
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (char ch : path) {
+            hash ^= uint8_t(ch);
+            hash *= 0x100000001b3ULL;
+        }
+
+        // Keep extension, so cached files can be opened by other programs.
+        std::string extension;
+        std::string withoutQuery = path.substr(0, path.find('?'));
+        size_t dot   = withoutQuery.rfind('.');
+        size_t slash = withoutQuery.rfind('/');
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+            extension = withoutQuery.substr(dot);
+        }
+
+        return toHex(hash, 16) + extension;
+    }
+
+    REST::HTTPRequest CdnClient::buildRequest(const std::string& path) const {
+        REST::HTTPRequest request;
+        request.method  = "GET";
+        request.path    = path;
+        request.version = 11;
+        return request;
+    }
+
+    void CdnClient::checkResponse(const REST::HTTPResponse& response) {
+        if (response.statusCode != 200) {
+            throw LogicError(std::string("HTTP status code: ") + std::to_string(response.statusCode), -1);
+        }
+        if (response.body.empty()) {
+            throw LogicError("Response body is empty (are you trying to download non-animated avatar as GIF?)", -1);
+        }
+    }
+
+    bool CdnClient::readCache(const std::string& path, SharedBuffer& bytes) const {
+        if (cacheDirectory.empty()) return false;
+
+        std::string cachePath = cacheDirectory + "/" + cacheKey(path);
+        if (!std::ifstream(cachePath).good()) return false;
+
+        try {
+            bytes = File::map(cachePath).bytes;
+        } catch (RuntimeError& excp) {
+            DEBUG_MSG(std::string("Failed to read cached file: ") + excp.what());
+            return false;
+        }
+        return !bytes.empty();
+    }
+
+    void CdnClient::writeCache(const std::string& path, const SharedBuffer& bytes) {
+        if (cacheDirectory.empty()) return;
+
+        // Cache is best-effort, download is not failed if it can't be written.
+        std::string cachePath = cacheDirectory + "/" + cacheKey(path);
+        std::string tempPath  = cachePath + ".tmp-" + tempSuffix + "-" + std::to_string(tempCounter++);
+        {
+            std::ofstream output(tempPath, std::ios_base::binary | std::ios_base::trunc);
+            output.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            output.close();
+            if (!output) {
+                DEBUG_MSG(std::string("Failed to write cache file ") + tempPath);
+                std::remove(tempPath.c_str());
+                return;
+            }
+        }
+
+        if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+            DEBUG_MSG(std::string("Failed to rename cache file ") + tempPath);
+            std::remove(tempPath.c_str());
+        }
+    }
+} // namespace Hexicord
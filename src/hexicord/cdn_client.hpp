@@ -0,0 +1,127 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_CDN_CLIENT_HPP
+#define HEXICORD_CDN_CLIENT_HPP
+
+#include <atomic>                      // std::atomic
+#include <exception>                   // std::exception_ptr
+#include <functional>                  // std::function
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+#include <boost/asio/io_service.hpp>   // boost::asio::io_service
+#include <hexicord/internal/rest.hpp>  // REST::HTTPSConnectionPool
+#include <hexicord/types/shared_buffer.hpp>
+
+namespace Hexicord {
+
+    /**
+     * Downloads files (avatars, icons, emojis, etc) from cdn.discordapp.com.
+     *
+     * Keep-alive connections are pooled, so only first requests pay for
+     * TLS handshake. Asynchronous downloads run concurrently on up to
+     * maxConnections connections.
+     *
+     * If cacheDirectory is set, downloaded files are stored there in files
+     * named after hash of path (including query) and are never requested
+     * again: CDN paths contain image hash, so content under same path never
+     * changes. Cached files are memory-mapped when read (see \ref File::map).
+     *
+     * CdnClient can be used by many threads at once.
+     */
+    class CdnClient {
+    public:
+        /**
+         * \param ioService      ASIO I/O service. Should not be destroyed
+         *                       while CdnClient exists.
+         * \param cacheDirectory Existing directory used for disk cache,
+         *                       empty string disables caching.
+         * \param maxConnections Limit of simultaneous connections used by
+         *                       asynchronous downloads.
+         */
+        CdnClient(boost::asio::io_service& ioService, const std::string& cacheDirectory = "",
+                  size_t maxConnections = 8);
+
+        CdnClient(const CdnClient&) = delete;
+        CdnClient& operator=(const CdnClient&) = delete;
+
+        /**
+         * Download file at path (e.g. "/avatars/{user}/{hash}.png?size=2048")
+         * or read it from cache.
+         *
+         * Throws LogicError if response is not 200 OK or body is empty
+         * (happens if non-animated image requested as GIF) and
+         * boost::system::system_error on connection error.
+         */
+        SharedBuffer download(const std::string& path);
+
+        using DownloadHandler = std::function<void(std::exception_ptr error, SharedBuffer bytes)>;
+
+        /**
+         * Asynchronous version of \ref download. Handler is invoked from
+         * I/O service thread with exception pointer set on error (same
+         * exceptions as \ref download throws).
+         *
+         * Cache lookups are performed by calling thread.
+         */
+        void asyncDownload(const std::string& path, DownloadHandler handler);
+
+        struct Download {
+            std::string path;
+            std::exception_ptr error;
+            SharedBuffer bytes;
+        };
+
+        using BatchHandler = std::function<void(std::vector<Download> results)>;
+
+        /**
+         * Download all paths concurrently, handler is invoked once all of
+         * them are finished, results are in same order as paths. Failed
+         * downloads don't stop others, they have error set instead.
+         */
+        void asyncDownloadBatch(const std::vector<std::string>& paths, BatchHandler handler);
+
+        /**
+         * Name of cache file for path (without directory).
+         */
+        static std::string cacheKey(const std::string& path);
+
+        const std::string cacheDirectory;
+    private:
+        REST::HTTPRequest buildRequest(const std::string& path) const;
+
+        // Throw if response is not a successful download.
+        static void checkResponse(const REST::HTTPResponse& response);
+
+        bool readCache(const std::string& path, SharedBuffer& bytes) const;
+        void writeCache(const std::string& path, const SharedBuffer& bytes);
+
+        boost::asio::io_service& ioService; // non-owning reference to I/O service.
+        REST::HTTPSConnectionPool pool;
+
+        // Temporary cache files are renamed when complete, so readers
+        // never see partially written file.
+        const std::string tempSuffix;
+        std::atomic<unsigned> tempCounter;
+    };
+} // namespace Hexicord
+
+#endif // HEXICORD_CDN_CLIENT_HPP
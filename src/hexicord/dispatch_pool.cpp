@@ -0,0 +1,214 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/dispatch_pool.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef HEXICORD_DEBUG_LOG
+    #include <iostream>
+    #define DEBUG_MSG(msg) do { std::cerr <<  "dispatch_pool.cpp:" << __LINE__ << " " << (msg) << '\n'; } while (false)
+#else
+    #define DEBUG_MSG(msg)
+#endif
+
+namespace Hexicord {
+
+constexpr std::size_t DispatchPool::defaultQueueCapacity;
+constexpr std::size_t DispatchPool::eventsCount;
+
+namespace {
+    uint64_t userIdKey(const GatewayJson& payload) {
+        auto user = payload.find("user");
+        if (user == payload.end() || !user->is_object()) return 0;
+
+        auto id = user->find("id");
+        if (id == user->end()) return 0;
+
+        if (id->is_string()) return std::hash<std::string>()(id->get_ref<const std::string&>());
+        if (id->is_number()) return id->get<uint64_t>();
+        return 0;
+    }
+} // anonymous namespace
+
+DispatchPool::DispatchPool(unsigned workersCount, std::size_t queueCapacity)
+    : capacity(std::max(std::size_t(1), queueCapacity)) {
+
+    for (std::size_t i = 0; i < eventsCount; ++i) {
+        dropped[i]   = 0;
+        coalesced[i] = 0;
+    }
+
+    // Presence updates are the most frequent events and only latest one matters,
+    // typing notifications are useless once stale.
+    setPolicy(Event::PresenceUpdate, QueuePolicy::Coalesce, userIdKey);
+    setPolicy(Event::TypingStart,    QueuePolicy::DropOldest);
+
+    if (workersCount == 0) workersCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < workersCount; ++i) {
+        workers.emplace_back(new Worker);
+    }
+    // Started only after all workers are constructed.
+    for (auto& worker : workers) {
+        Worker& workerRef = *worker;
+        worker->thread = std::thread([this, &workerRef]() { runWorker(workerRef); });
+    }
+}
+
+DispatchPool::~DispatchPool() {
+    stop();
+}
+
+void DispatchPool::setPolicy(Event type, QueuePolicy policy, CoalesceKey key) {
+    if (policy == QueuePolicy::Coalesce && !key) {
+        throw std::invalid_argument("Coalesce policy requires key function");
+    }
+
+    policies[std::size_t(type)].policy = policy;
+    policies[std::size_t(type)].key    = std::move(key);
+}
+
+void DispatchPool::post(EventDispatcher::Task task) {
+    // Snowflakes have increment counter in low bits, so mix key
+    // before taking modulo to spread guilds evenly.
+    Worker& worker = *workers[hashSnowflake(task.orderingKey) % workers.size()];
+
+    const std::size_t typeIndex = std::size_t(task.type);
+    const Policy& policy = policies[typeIndex];
+
+    uint64_t coalesceKey = 0;
+    if (policy.policy == QueuePolicy::Coalesce) coalesceKey = policy.key(*task.payload);
+
+    {
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        if (worker.stopping) return;
+
+        if (policy.policy == QueuePolicy::Coalesce) {
+            auto it = worker.coalesceIndex.find({ task.type, task.orderingKey, coalesceKey });
+            if (it != worker.coalesceIndex.end()) {
+                // Keeps position of older event, so ordering with other events is
+                // mostly preserved.
+                it->second->task = std::move(task);
+                ++coalesced[typeIndex];
+                return;
+            }
+        }
+
+        if (worker.tasks.size() >= capacity) {
+            switch (policy.policy) {
+            case QueuePolicy::Block:
+                worker.spaceAvailable.wait(lock, [&]() { return worker.stopping || worker.tasks.size() < capacity; });
+                if (worker.stopping) return;
+                break;
+            case QueuePolicy::DropOldest:
+            case QueuePolicy::Coalesce:
+                if (dropOldest(worker, task.type)) break;
+                // fallthrough: nothing to drop, drop new event.
+            case QueuePolicy::DropNewest:
+                ++dropped[typeIndex];
+                return;
+            }
+        }
+
+        Event type = task.type;
+        uint64_t orderingKey = task.orderingKey;
+        worker.tasks.push_back({ std::move(task), coalesceKey });
+        worker.queuedByType[typeIndex].push_back(std::prev(worker.tasks.end()));
+        if (policy.policy == QueuePolicy::Coalesce) {
+            worker.coalesceIndex.emplace(CoalesceId{ type, orderingKey, coalesceKey }, std::prev(worker.tasks.end()));
+        }
+    }
+    worker.wakeup.notify_one();
+}
+
+bool DispatchPool::dropOldest(Worker& worker, Event type) {
+    const auto& queued = worker.queuedByType[std::size_t(type)];
+    if (queued.empty()) return false;
+
+    erase(worker, queued.front());
+    ++dropped[std::size_t(type)];
+    return true;
+}
+
+void DispatchPool::erase(Worker& worker, std::list<QueuedTask>::iterator it) {
+    worker.queuedByType[std::size_t(it->task.type)].pop_front();
+    if (policies[std::size_t(it->task.type)].policy == QueuePolicy::Coalesce) {
+        worker.coalesceIndex.erase({ it->task.type, it->task.orderingKey, it->coalesceKey });
+    }
+    worker.tasks.erase(it);
+}
+
+EventDispatcher::Executor DispatchPool::executor() {
+    return [this](EventDispatcher::Task task) {
+        post(std::move(task));
+    };
+}
+
+void DispatchPool::setExceptionHandler(ExceptionHandler handler) {
+    exceptionHandler = std::move(handler);
+}
+
+void DispatchPool::stop() {
+    for (auto& worker : workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->stopping = true;
+    }
+    for (auto& worker : workers) {
+        worker->wakeup.notify_one();
+        worker->spaceAvailable.notify_all();
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+uint64_t DispatchPool::droppedCount(Event type) const {
+    return dropped[std::size_t(type)];
+}
+
+uint64_t DispatchPool::coalescedCount(Event type) const {
+    return coalesced[std::size_t(type)];
+}
+
+void DispatchPool::runWorker(Worker& worker) {
+    while (true) {
+        EventDispatcher::Task task;
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.wakeup.wait(lock, [&worker]() { return worker.stopping || !worker.tasks.empty(); });
+
+            if (worker.tasks.empty()) return; // stopping and nothing left.
+
+            task = std::move(worker.tasks.front().task);
+            erase(worker, worker.tasks.begin());
+        }
+        worker.spaceAvailable.notify_one();
+
+        try {
+            task();
+        } catch (...) {
+            DEBUG_MSG("Exception thrown from event handler.");
+            if (exceptionHandler) exceptionHandler(std::current_exception());
+        }
+    }
+}
+
+} // namespace Hexicord
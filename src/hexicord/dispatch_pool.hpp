@@ -0,0 +1,216 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_DISPATCH_POOL_HPP
+#define HEXICORD_DISPATCH_POOL_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <hexicord/event_dispatcher.hpp>
+#include <hexicord/gateway_json.hpp>
+#include <hexicord/types/snowflake.hpp>
+
+namespace Hexicord {
+    /**
+     * What to do with event when worker queue is full.
+     */
+    enum class QueuePolicy {
+        /// Wait until there is free space. Blocks dispatching thread
+        /// (gateway I/O thread), so socket is not read meanwhile.
+        Block,
+        /// Drop oldest queued event of same type, or new event if there is none.
+        DropOldest,
+        /// Drop new event.
+        DropNewest,
+        /// Replace queued event of same type with the same key (see
+        /// \ref DispatchPool::CoalesceKey) even if queue is not full,
+        /// otherwise behave like DropOldest.
+        Coalesce
+    };
+
+    /**
+     * Fixed-size worker pool for event handlers.
+     *
+     * Each task has ordering key (guild or channel ID), tasks with the same
+     * key always go to the same worker, so they are run one by one in
+     * submission order (like with strand), while tasks with different keys
+     * run in parallel.
+     *
+     * Each worker has bounded queue, what happens when it's full is
+     * determined by per-event \ref QueuePolicy. By default PresenceUpdate
+     * events are coalesced by user ID, oldest TypingStart are dropped when
+     * queue is full and other events use Block, so state tracked by \ref Cache
+     * and \ref PermissionResolver is never lost. Dropped events are counted
+     * by \ref droppedCount.
+     *
+     * Usage:
+     * ```cpp
+     * Hexicord::DispatchPool pool(4);
+     * gclient.eventDispatcher.setExecutor(pool.executor());
+     * ```
+     * Pool should outlive all dispatchers using it and should be stopped
+     * before they're destroyed.
+     */
+    class DispatchPool {
+    public:
+        using ExceptionHandler = std::function<void(std::exception_ptr)>;
+
+        /**
+         * Returns key used to find events to coalesce (for example, user ID).
+         */
+        using CoalesceKey = std::function<uint64_t(const GatewayJson& payload)>;
+
+        static constexpr std::size_t defaultQueueCapacity = 10000;
+
+        /**
+         * Start workersCount threads, 0 means "use hardware concurrency".
+         * queueCapacity is limit of queued events per worker.
+         */
+        explicit DispatchPool(unsigned workersCount = 0, std::size_t queueCapacity = defaultQueueCapacity);
+
+        /**
+         * Calls \ref stop.
+         */
+        ~DispatchPool();
+
+        DispatchPool(const DispatchPool&) = delete;
+        DispatchPool& operator=(const DispatchPool&) = delete;
+
+        /**
+         * Set queue policy for event type, key is required for Coalesce.
+         * Should be called before posting any tasks.
+         */
+        void setPolicy(Event type, QueuePolicy policy, CoalesceKey key = nullptr);
+
+        /**
+         * Queue task to worker selected by task.orderingKey.
+         *
+         * This method is thread-safe.
+         */
+        void post(EventDispatcher::Task task);
+
+        /**
+         * Executor for \ref EventDispatcher::setExecutor, which posts to this pool.
+         */
+        EventDispatcher::Executor executor();
+
+        /**
+         * Called from worker thread with exception thrown by task.
+         * By default such exceptions are ignored. Should be set before
+         * posting any tasks.
+         */
+        void setExceptionHandler(ExceptionHandler handler);
+
+        /**
+         * Finish already queued tasks and join workers. Tasks posted after
+         * stop are discarded.
+         */
+        void stop();
+
+        /**
+         * Count of events of this type dropped because of full queue.
+         */
+        uint64_t droppedCount(Event type) const;
+
+        /**
+         * Count of events of this type replaced by newer ones.
+         */
+        uint64_t coalescedCount(Event type) const;
+
+        inline unsigned workersCount() const {
+            return unsigned(workers.size());
+        }
+
+        inline std::size_t queueCapacity() const {
+            return capacity;
+        }
+    private:
+        static constexpr std::size_t eventsCount = std::size_t(Event::WebhooksUpdate) + 1;
+
+        struct Policy {
+            QueuePolicy policy = QueuePolicy::Block;
+            CoalesceKey key;
+        };
+
+        struct QueuedTask {
+            EventDispatcher::Task task;
+            uint64_t coalesceKey;
+        };
+
+        // Identifies events which can replace each other.
+        struct CoalesceId {
+            Event type;
+            uint64_t orderingKey;
+            uint64_t coalesceKey;
+
+            bool operator==(const CoalesceId& other) const {
+                return type == other.type && orderingKey == other.orderingKey &&
+                       coalesceKey == other.coalesceKey;
+            }
+        };
+
+        struct CoalesceIdHash {
+            std::size_t operator()(const CoalesceId& id) const {
+                return std::size_t(hashSnowflake(id.orderingKey ^ hashSnowflake(id.coalesceKey))) ^ std::size_t(id.type);
+            }
+        };
+
+        struct Worker {
+            std::mutex mutex;
+            std::condition_variable wakeup, spaceAvailable;
+            std::list<QueuedTask> tasks;
+            std::unordered_map<CoalesceId, std::list<QueuedTask>::iterator, CoalesceIdHash> coalesceIndex;
+            // Queued tasks of each type, oldest first.
+            std::array<std::deque<std::list<QueuedTask>::iterator>, eventsCount> queuedByType;
+            bool stopping = false;
+            std::thread thread;
+        };
+
+        void runWorker(Worker& worker);
+
+        // Remove oldest queued event of this type, returns false if there is none.
+        // worker.mutex should be locked.
+        bool dropOldest(Worker& worker, Event type);
+        // it should be oldest queued task of its type.
+        void erase(Worker& worker, std::list<QueuedTask>::iterator it);
+
+        std::size_t capacity;
+        std::array<Policy, eventsCount> policies;
+        std::array<std::atomic<uint64_t>, eventsCount> dropped, coalesced;
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        ExceptionHandler exceptionHandler;
+    };
+}
+
+#endif // HEXICORD_DISPATCH_POOL_HPP
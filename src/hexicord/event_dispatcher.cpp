@@ -27,9 +27,75 @@ namespace Hexicord {
         handlers[eventType].push_back(handler);
     }
 
-    void EventDispatcher::dispatchEvent(Event type, const nlohmann::json& payload) const {
-        for (auto handler : handlers.at(type)) {
+    bool EventDispatcher::hasHandlers(Event eventType) const {
+        return !handlers.at(eventType).empty();
+    }
+
+    void EventDispatcher::setExecutor(Executor executor, Ordering ordering) {
+        this->executor = std::move(executor);
+        this->ordering = ordering;
+    }
+
+    void EventDispatcher::dispatchEvent(Event type, const GatewayJson& payload) const {
+        if (!executor) {
+            invokeHandlers(type, payload);
+            return;
+        }
+        dispatchEvent(type, GatewayJson(payload));
+    }
+
+    void EventDispatcher::dispatchEvent(Event type, GatewayJson&& payload) const {
+        if (!executor) {
+            invokeHandlers(type, payload);
+            return;
+        }
+        if (!hasHandlers(type)) return;
+
+        Task task;
+        task.type        = type;
+        task.orderingKey = orderingKey(type, payload);
+        task.payload     = std::make_shared<const GatewayJson>(std::move(payload));
+        task.invoke      = [this, type](const GatewayJson& payload) {
+            invokeHandlers(type, payload);
+        };
+        executor(std::move(task));
+    }
+
+    void EventDispatcher::invokeHandlers(Event type, const GatewayJson& payload) const {
+        for (const auto& handler : handlers.at(type)) {
             handler(payload);
         }
     }
+
+    uint64_t EventDispatcher::orderingKey(Event type, const GatewayJson& payload) const {
+        if (!payload.is_object()) return 0;
+
+        auto idToKey = [](const GatewayJson& id) -> uint64_t {
+            // Snowflakes are strings in JSON (and in ETF if they don't fit into 32 bits).
+            if (id.is_string())          return std::hash<std::string>()(id.get_ref<const std::string&>());
+            if (id.is_number_unsigned()) return id.get<uint64_t>();
+            if (id.is_number_integer())  return uint64_t(id.get<int64_t>());
+            return 0;
+        };
+
+        // For these events "id" is ID of guild or channel itself.
+        bool isGuildEvent   = type == Event::GuildCreate   || type == Event::GuildUpdate   || type == Event::GuildDelete;
+        bool isChannelEvent = type == Event::ChannelCreate || type == Event::ChannelUpdate || type == Event::ChannelDelete;
+
+        if (ordering == Ordering::PerChannel) {
+            auto it = payload.find("channel_id");
+            if (it != payload.end()) return idToKey(*it);
+            if (isChannelEvent && payload.count("id")) return idToKey(payload["id"]);
+        }
+
+        auto it = payload.find("guild_id");
+        if (it != payload.end()) return idToKey(*it);
+        if (isGuildEvent && payload.count("id")) return idToKey(payload["id"]);
+
+        it = payload.find("channel_id");
+        if (it != payload.end()) return idToKey(*it);
+        if (isChannelEvent && payload.count("id")) return idToKey(payload["id"]);
+
+        return 0;
+    }
 }
@@ -22,8 +22,12 @@
 #ifndef HEXICORD_EVENTDISPATCHER_HPP
 #define HEXICORD_EVENTDISPATCHER_HPP 
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include <hexicord/json.hpp>
+#include <hexicord/gateway_json.hpp>
 
 namespace Hexicord {
     enum class Event {
@@ -69,13 +73,85 @@ namespace Hexicord {
 
     class EventDispatcher {
     public:
-        using EventHandler        = std::function<void(const nlohmann::json&)>;
-        using UnknownEventHandler = std::function<void(const std::string&, const nlohmann::json&)>;
+        /**
+         * Handlers receive payload as \ref GatewayJson, which is nlohmann::json
+         * unless library is built with HEXICORD_ARENA_JSON. Payload is valid
+         * only during call, copy what you need to keep.
+         */
+        using EventHandler        = std::function<void(const GatewayJson&)>;
+        using UnknownEventHandler = std::function<void(const std::string&, const GatewayJson&)>;
+
+        /**
+         * Handlers invocation for single event, passed to executor.
+         */
+        struct Task {
+            Event type;
+            uint64_t orderingKey; // guild or channel ID (hashed), 0 if none.
+            std::shared_ptr<const GatewayJson> payload;
+            std::function<void(const GatewayJson&)> invoke;
+
+            void operator()() const {
+                invoke(*payload);
+            }
+        };
+
+        /**
+         * Runs task, possibly in other thread. Tasks with same orderingKey
+         * must be run in order they were submitted. See \ref DispatchPool.
+         */
+        using Executor = std::function<void(Task task)>;
+
+        /**
+         * What events should be kept ordered when executor is used.
+         */
+        enum class Ordering {
+            PerGuild,  ///< Events of same guild are handled in order.
+            PerChannel ///< Events of same channel are handled in order, guild-wide events - per guild.
+        };
 
         void addHandler(Event eventType, EventHandler handler);
 
-        void dispatchEvent(Event type, const nlohmann::json& payload) const;
+        /**
+         * Run handlers using executor instead of calling them inline (from
+         * I/O thread in case of \ref GatewayClient), so slow handlers don't
+         * delay heartbeats and events of different guilds (or channels) are
+         * processed in parallel. Pass nullptr to disable.
+         *
+         * \warning Handlers should not be added and dispatcher should not be
+         *          destroyed while executor still runs tasks.
+         */
+        void setExecutor(Executor executor, Ordering ordering = Ordering::PerGuild);
+
+        /**
+         * Check whether at least one handler is registered for
+         * specified event type.
+         *
+         * Used by GatewayClient to skip parsing of event payloads
+         * nobody is interested in.
+         */
+        bool hasHandlers(Event eventType) const;
+
+        /**
+         * Call handlers for event. If executor is set, payload is copied
+         * and handlers are invoked through it.
+         */
+        void dispatchEvent(Event type, const GatewayJson& payload) const;
+
+        /**
+         * Same as above, but avoids copying payload when executor is set.
+         */
+        void dispatchEvent(Event type, GatewayJson&& payload) const;
     private:
+        // Guild or channel ID (depending on ordering) of event,
+        // used to keep events ordered, 0 if none.
+        uint64_t orderingKey(Event type, const GatewayJson& payload) const;
+
+        // Call handlers in current thread.
+        void invokeHandlers(Event type, const GatewayJson& payload) const;
+
+        Executor executor;
+        Ordering ordering = Ordering::PerGuild;
+
         static const std::unordered_map<std::string, Event> stringToEnum;
 
         std::unordered_map<Event, std::vector<EventHandler>, EventHash> handlers {
@@ -21,9 +21,11 @@
 
 #include <hexicord/gateway_client.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <hexicord/config.hpp>
 #include <hexicord/internal/utils.hpp>
+#include <hexicord/internal/etf.hpp>
 #ifdef HEXICORD_ZLIB
 #include <hexicord/internal/zlib.hpp>
 #endif
@@ -52,41 +54,167 @@
 
 namespace Hexicord {
 
-GatewayClient::GatewayClient(boost::asio::io_service& ioService, const std::string& token)
-    : ioService(ioService), token_(token), heartbeatTimer(ioService) {}
+namespace {
+    const std::unordered_map<std::string, Event>& eventsByName() {
+        static const std::unordered_map<std::string, Event> stringToEnum {
+            { "READY",                          Event::Ready                },
+            { "RESUMED",                        Event::Resumed              },
+            { "CHANNEL_CREATE",                 Event::ChannelCreate        },
+            { "CHANNEL_UPDATE",                 Event::ChannelUpdate        },
+            { "CHANNEL_DELETE",                 Event::ChannelDelete        },
+            { "CHANNEL_PINS_CHANGE",            Event::ChannelPinsChange    },
+            { "GUILD_CREATE",                   Event::GuildCreate          },
+            { "GUILD_UPDATE",                   Event::GuildUpdate          },
+            { "GUILD_DELETE",                   Event::GuildDelete          },
+            { "GUILD_BAN_ADD",                  Event::GuildBanAdd          },
+            { "GUILD_BAN_REMOVE",               Event::GuildBanRemove       },
+            { "GUILD_EMOJIS_UPDATE",            Event::GuildEmojisUpdate    },
+            { "GUILD_INTEGRATIONS_UPDATE",      Event::GuildIntegrationsUpdate },
+            { "GUILD_MEMBER_ADD",               Event::GuildMemberAdd       },
+            { "GUILD_MEMBER_REMOVE",            Event::GuildMemberRemove    },
+            { "GUILD_MEMBER_UPDATE",            Event::GuildMemberUpdate    },
+            { "GUILD_MEMBERS_CHUNK",            Event::GuildMembersChunk    },
+            { "GUILD_ROLE_CREATE",              Event::GuildRoleCreate      },
+            { "GUILD_ROLE_UPDATE",              Event::GuildRoleUpdate      },
+            { "GUILD_ROLE_DELETE",              Event::GuildRoleDelete      },
+            { "MESSAGE_CREATE",                 Event::MessageCreate        },
+            { "MESSAGE_UPDATE",                 Event::MessageUpdate        },
+            { "MESSAGE_DELETE",                 Event::MessageDelete        },
+            { "MESSAGE_DELETE_BULK",            Event::MessageDeleteBulk    },
+            { "MESSAGE_REACTION_ADD",           Event::MessageReactionAdd   },
+            { "MESSAGE_REACTION_REMOVE_ALL",    Event::MessageReactionRemoveAll },
+            { "PRESENCE_UPDATE",                Event::PresenceUpdate       },
+            { "TYPING_START",                   Event::TypingStart          },
+            { "USER_UPDATE",                    Event::UserUpdate           },
+            { "VOICE_STATE_UPDATE",             Event::VoiceStateUpdate     },
+            { "VOICE_SERVER_UPDATE",            Event::VoiceServerUpdate    },
+            { "WEBHOOKS_UPDATE",                Event::WebhooksUpdate       }
+        };
+        return stringToEnum;
+    }
+
+    // Parse JSON gateway payload, but skip building "d" if it's not needed.
+    //
+    // Parser callback sees top-level keys at depth 1, so once "t" is read
+    // we can decide whether to discard "d" object when it starts. Discarded
+    // values are only tokenized, no DOM is built for them. If gateway sends
+    // "d" before "t" - it's parsed as usual.
+    GatewayJson parseJsonEnvelope(const uint8_t* payload, std::size_t size,
+                                     const std::function<bool(const std::string&)>& isPayloadNeeded) {
+        // Callback captures single pointer, so std::function don't allocate.
+        struct {
+            std::string lastKey;
+            bool skipPayload = false;
+            const std::function<bool(const std::string&)>* isPayloadNeeded;
+        } state;
+        state.isPayloadNeeded = &isPayloadNeeded;
+
+        GatewayJson result = GatewayJson::parse(payload, payload + size,
+            [&state](int depth, GatewayJson::parse_event_t event, GatewayJson& parsed) {
+                if (depth != 1) return true;
+
+                switch (event) {
+                case GatewayJson::parse_event_t::key:
+                    state.lastKey = parsed.get_ref<const std::string&>();
+                    break;
+                case GatewayJson::parse_event_t::value:
+                    if (state.lastKey == "t" && parsed.is_string()) {
+                        state.skipPayload = !(*state.isPayloadNeeded)(parsed.get_ref<const std::string&>());
+                    }
+                    break;
+                case GatewayJson::parse_event_t::object_start:
+                case GatewayJson::parse_event_t::array_start:
+                    if (state.lastKey == "d" && state.skipPayload) return false;
+                    break;
+                default:
+                    break;
+                }
+                return true;
+            });
+
+        if (state.skipPayload && result.find("d") == result.end()) result["d"] = nullptr;
+        return result;
+    }
+
+    // Passed to ConnectHandler if connection was closed during connect.
+    std::exception_ptr abortedError() {
+        return std::make_exception_ptr(boost::system::system_error(boost::asio::error::operation_aborted));
+    }
+} // anonymous namespace
+
+GatewayClient::GatewayClient(boost::asio::io_service& ioService, const std::string& token, Encoding encoding)
+    : recoveryTimer(ioService), sendTimer(ioService), heartbeatTimer(ioService), token_(token),
+      encoding_(encoding), ioService(ioService) {}
+
+constexpr unsigned GatewayClient::commandsLimit;
+constexpr unsigned GatewayClient::commandsWindowMs;
 
 GatewayClient::~GatewayClient() {
     if (gatewayConnection && activeSession && gatewayConnection->isSocketOpen()) disconnect(2000);
 }
 
-nlohmann::json GatewayClient::parseGatewayMessage(const std::vector<uint8_t>& msg) {
-#ifdef HEXICORD_ZLIB
-    if (msg[0] == '{') {
-        return nlohmann::json::parse(msg);
+GatewayJson GatewayClient::parseGatewayMessage(const uint8_t* data, std::size_t size) {
+#if defined(HEXICORD_ZLIB_STREAM)
+    // inflatedMessage keeps capacity between messages.
+    if (!transportInflate.feed(data, size, inflatedMessage)) {
+        DEBUG_MSG("Partial zlib-stream message, waiting for sync flush...");
+        return nullptr;
+    }
+    return decodePayload(inflatedMessage.data(), inflatedMessage.size());
+#elif defined(HEXICORD_ZLIB)
+    // Uncompressed payloads start with '{' (JSON) or version byte (ETF).
+    if (size == 0 || data[0] == '{' || data[0] == 131) {
+        return decodePayload(data, size);
     }
-    return nlohmann::json::parse(Zlib::decompress(msg));
+    std::vector<uint8_t> decompressed = Zlib::decompress(std::vector<uint8_t>(data, data + size));
+    return decodePayload(decompressed.data(), decompressed.size());
 #else
-    return nlohmann::json::parse(msg);
+    return decodePayload(data, size);
 #endif
 }
 
-void GatewayClient::connect(const std::string& gatewayUrl, int shardId, int shardCount,
-                            const nlohmann::json& initialPresence) {
+GatewayJson GatewayClient::parseGatewayMessage(const std::vector<uint8_t>& msg) {
+    return parseGatewayMessage(msg.data(), msg.size());
+}
 
-    if (activeSession) disconnect(2000);
-    activeSession = false;
+GatewayJson GatewayClient::decodePayload(const uint8_t* payload, std::size_t size) const {
+#ifdef HEXICORD_ARENA_JSON
+    // Arena is recycled when document (and all its parts) is destroyed.
+    ArenaScope arenaScope(size);
+#endif
+    auto filter = [this](const std::string& eventName) { return isPayloadNeeded(eventName); };
 
-    DEBUG_MSG("Connecting...");
-    if (!gatewayConnection)                 gatewayConnection.reset(new TLSWebSocket(ioService));
-    if (!gatewayConnection->isSocketOpen()) gatewayConnection->handshake(Utils::domainFromUrl(gatewayUrl),
-                                                                         gatewayPathSuffix, 443);
+    if (encoding_ == Encoding::Etf) return Etf::decode(payload, size, filter);
+    return parseJsonEnvelope(payload, size, filter);
+}
 
-    DEBUG_MSG("Reading Hello message...");
-    nlohmann::json gatewayHello = parseGatewayMessage(gatewayConnection->readMessage());
+bool GatewayClient::isPayloadNeeded(const std::string& eventName) const {
+    auto it = eventsByName().find(eventName);
+    if (it == eventsByName().end()) return true; // let processMessage handle it.
 
-    heartbeatIntervalMs = gatewayHello["d"]["heartbeat_interval"];
-    DEBUG_MSG(std::string("Gateway heartbeat interval: ") + std::to_string(heartbeatIntervalMs) + " ms.");
+    // Ready and Resumed payloads are used by connect and resume.
+    return it->second == Event::Ready || it->second == Event::Resumed ||
+           (skipMessages && it->second == awaitedEvent) ||
+           eventDispatcher.hasHandlers(it->second);
+}
+
+std::vector<uint8_t> GatewayClient::encodePayload(const nlohmann::json& payload) const {
+    if (encoding_ == Encoding::Etf) return Etf::encode(payload);
+
+    std::string payloadString = payload.dump();
+    return std::vector<uint8_t>(payloadString.begin(), payloadString.end());
+}
+
+std::string GatewayClient::gatewayPath() const {
+    std::string path = "/?v=6&encoding=";
+    path += (encoding_ == Encoding::Etf ? "etf" : "json");
+#ifdef HEXICORD_ZLIB_STREAM
+    path += "&compress=zlib-stream";
+#endif
+    return path;
+}
 
+nlohmann::json GatewayClient::identifyPayload(int shardId, int shardCount, const nlohmann::json& presence) const {
     nlohmann::json message = {
         { "token" , token_ },
         { "properties", {
@@ -94,25 +222,75 @@ void GatewayClient::connect(const std::string& gatewayUrl, int shardId, int shar
             { "$browser", "hexicord" },
             { "$device", "hexicord" }
         }},
-#ifdef HEXICORD_ZLIB
+#if defined(HEXICORD_ZLIB) && !defined(HEXICORD_ZLIB_STREAM)
+        // Payload compression can't be used together with transport compression.
         { "compress", true },
 #else
         { "compress", false },
 #endif
         { "large_threshold", 250 }, // should be changeble
-        { "presence", initialPresence }
+        { "presence", presence }
     };
 
-
     if (shardId != NoSharding && shardCount != NoSharding) {
         message.push_back({ "shard", { shardId, shardCount }});
     }
+    return message;
+}
+
+void GatewayClient::startSession() {
+    activeSession = true;
+    skipMessages = false;
+    unansweredHeartbeats = 0;
+
+    heartbeat = true;
+    asyncHeartbeat();
+    poll = true;
+    asyncPoll();
+
+    // Messages queued while we were disconnected.
+    flushSendQueue();
+}
+
+void GatewayClient::connect(const std::string& gatewayUrl, int shardId, int shardCount,
+                            const nlohmann::json& initialPresence) {
+
+    if (activeSession) disconnect(2000);
+    activeSession = false;
+
+    DEBUG_MSG("Connecting...");
+    if (!gatewayConnection)                 gatewayConnection = std::make_shared<TLSWebSocket>(ioService);
+    if (!gatewayConnection->isSocketOpen()) {
+#ifdef HEXICORD_ZLIB_STREAM
+        transportInflate.reset();
+#endif
+        gatewayConnection->handshake(Utils::domainFromUrl(gatewayUrl), gatewayPath(), 443);
+        // ETF payloads must be sent in binary frames.
+        gatewayConnection->wsStream.binary(encoding_ == Encoding::Etf);
+    }
+
+    DEBUG_MSG("Reading Hello message...");
+    GatewayJson gatewayHello;
+    while (gatewayHello.is_null()) gatewayHello = parseGatewayMessage(gatewayConnection->readMessage());
+
+    heartbeatIntervalMs = gatewayHello["d"]["heartbeat_interval"];
+    DEBUG_MSG(std::string("Gateway heartbeat interval: ") + std::to_string(heartbeatIntervalMs) + " ms.");
+
+    if (beforeIdentify) {
+        DEBUG_MSG("Waiting for identify permission...");
+        bool allowed = false;
+        beforeIdentify([&allowed]() { allowed = true; });
+        while (!allowed) {
+            if (ioService.run_one() == 0) ioService.reset();
+        }
+    }
 
     DEBUG_MSG("Sending Identify message...");
-    sendMessage(OpCode::Identify, message);
+    lastSequenceNumber_ = 0;
+    sendMessage(OpCode::Identify, identifyPayload(shardId, shardCount, initialPresence));
 
     DEBUG_MSG("Waiting for Ready event...");
-    nlohmann::json readyPayload = waitForEvent(Event::Ready);
+    GatewayJson readyPayload = waitForEvent(Event::Ready);
 
     DEBUG_MSG("Got Ready event. Starting heartbeat and polling...");
 
@@ -124,15 +302,9 @@ void GatewayClient::connect(const std::string& gatewayUrl, int shardId, int shar
     lastGatewayUrl_     = gatewayUrl;
     shardId_            = shardId;
     shardCount_         = shardCount;
-    lastSequenceNumber_ = 0;
     lastPresence        = initialPresence;
 
-    activeSession = true;
-
-    heartbeat = true;
-    asyncHeartbeat();
-    poll = true;
-    asyncPoll();
+    startSession();
 }
 
 void GatewayClient::resume(const std::string& gatewayUrl,
@@ -144,14 +316,24 @@ void GatewayClient::resume(const std::string& gatewayUrl,
 
     if (activeSession) disconnect(2000);
    
-    if (!gatewayConnection) gatewayConnection.reset(new TLSWebSocket(ioService));
-    if (!gatewayConnection->isSocketOpen()) gatewayConnection->handshake(Utils::domainFromUrl(gatewayUrl), gatewayPathSuffix, 443);
-
-    DEBUG_MSG("Performing WebSocket handshake...");
-    gatewayConnection->handshake(Utils::domainFromUrl(gatewayUrl), gatewayPathSuffix, 443);
+    if (!gatewayConnection) gatewayConnection = std::make_shared<TLSWebSocket>(ioService);
+    if (!gatewayConnection->isSocketOpen()) {
+        DEBUG_MSG("Performing WebSocket handshake...");
+#ifdef HEXICORD_ZLIB_STREAM
+        transportInflate.reset();
+#endif
+        gatewayConnection->handshake(Utils::domainFromUrl(gatewayUrl), gatewayPath(), 443);
+        // ETF payloads must be sent in binary frames.
+        gatewayConnection->wsStream.binary(encoding_ == Encoding::Etf);
+    }
 
     DEBUG_MSG("Reading Hello message.");
-    nlohmann::json gatewayHello = parseGatewayMessage(gatewayConnection->readMessage());
+    GatewayJson gatewayHello;
+    while (gatewayHello.is_null()) gatewayHello = parseGatewayMessage(gatewayConnection->readMessage());
+
+    // Set before replayed events are received, they update sequence number.
+    sessionId_          = sessionId;
+    lastSequenceNumber_ = lastSequenceNumber;
 
     DEBUG_MSG("Sending Resume message...");
     sendMessage(OpCode::Resume, {
@@ -165,43 +347,262 @@ void GatewayClient::resume(const std::string& gatewayUrl,
     // GatewayError can be thrown here, why?
     //  waitForEvent calls processMessage for other messages (including OP Invalid Session),
     //  processMessage throws GatewayError if receives Invalid Session.
-    nlohmann::json resumedPayload = waitForEvent(Event::Resumed);
+    GatewayJson resumedPayload = waitForEvent(Event::Resumed);
     DEBUG_MSG("Got Resumed event, starting heartbeat and polling...");
     eventDispatcher.dispatchEvent(Event::Resumed, resumedPayload);
 
     heartbeatIntervalMs = gatewayHello["d"]["heartbeat_interval"];
     lastGatewayUrl_     = gatewayUrl;
-    sessionId_          = sessionId;
-    lastSequenceNumber_ = lastSequenceNumber;
+    shardId_            = shardId;
+    shardCount_         = shardCount;
 
-    activeSession = true;
+    startSession();
+}
 
-    heartbeat = true;
-    asyncHeartbeat();
-    poll = true;
-    asyncPoll();
+void GatewayClient::asyncConnect(const std::string& gatewayUrl, ConnectHandler handler,
+                                 int shardId, int shardCount, const nlohmann::json& initialPresence) {
+
+    if (activeSession) disconnect(2000);
+    activeSession = false;
+
+    DEBUG_MSG("Connecting (async)...");
+    unsigned generation = connectionGeneration;
+    nlohmann::json identify = identifyPayload(shardId, shardCount, initialPresence);
+
+    asyncOpenSession(generation, gatewayUrl, [=]() {
+        auto sendIdentify = [=]() {
+            DEBUG_MSG("Sending Identify message...");
+            lastSequenceNumber_ = 0;
+            asyncSendPayload(generation, OpCode::Identify, identify, [=]() {
+                DEBUG_MSG("Waiting for Ready event...");
+                asyncAwaitEvent(generation, Event::Ready, [=](const GatewayJson& readyPayload) {
+                    DEBUG_MSG("Got Ready event. Starting heartbeat and polling...");
+
+                    sessionId_          = readyPayload["session_id"];
+                    lastGatewayUrl_     = gatewayUrl;
+                    shardId_            = shardId;
+                    shardCount_         = shardCount;
+                    lastPresence        = initialPresence;
+
+                    startSession();
+
+                    try {
+                        eventDispatcher.dispatchEvent(Event::Ready, readyPayload);
+                    } catch (...) {
+                        return handler(std::current_exception());
+                    }
+                    handler(nullptr);
+                }, handler);
+            }, handler);
+        };
+
+        if (beforeIdentify) {
+            DEBUG_MSG("Waiting for identify permission...");
+            beforeIdentify(sendIdentify);
+        } else {
+            sendIdentify();
+        }
+    }, handler);
+}
+
+void GatewayClient::asyncResume(const std::string& gatewayUrl,
+                                std::string sessionId, int lastSequenceNumber,
+                                ConnectHandler handler,
+                                int shardId, int shardCount) {
+
+    DEBUG_MSG(std::string("Resuming interrupted gateway session (async). sessionId=") + sessionId +
+              " lastSeq=" + std::to_string(lastSequenceNumber));
+
+    if (activeSession) disconnect(2000);
+
+    unsigned generation = connectionGeneration;
+    nlohmann::json resumePayload = {
+        { "token",      token_             },
+        { "session_id", sessionId          },
+        { "seq",        lastSequenceNumber }
+    };
+
+    asyncOpenSession(generation, gatewayUrl, [=]() {
+        // Set before replayed events are received, they update sequence number.
+        sessionId_          = sessionId;
+        lastSequenceNumber_ = lastSequenceNumber;
+
+        DEBUG_MSG("Sending Resume message...");
+        asyncSendPayload(generation, OpCode::Resume, resumePayload, [=]() {
+            DEBUG_MSG("Waiting for Resumed event...");
+            // Replayed events are dispatched by asyncAwaitEvent, Invalid Session
+            // passed to handler as GatewayError.
+            asyncAwaitEvent(generation, Event::Resumed, [=](const GatewayJson& resumedPayload) {
+                DEBUG_MSG("Got Resumed event, starting heartbeat and polling...");
+
+                lastGatewayUrl_     = gatewayUrl;
+                shardId_            = shardId;
+                shardCount_         = shardCount;
+
+                startSession();
+
+                try {
+                    eventDispatcher.dispatchEvent(Event::Resumed, resumedPayload);
+                } catch (...) {
+                    return handler(std::current_exception());
+                }
+                handler(nullptr);
+            }, handler);
+        }, handler);
+    }, handler);
+}
+
+void GatewayClient::asyncOpenSession(unsigned generation, const std::string& gatewayUrl,
+                                     std::function<void()> next, ConnectHandler handler) {
+
+    auto readHello = [this, generation, next, handler]() {
+        DEBUG_MSG("Reading Hello message...");
+        asyncReadPayload(generation, [this, next](const GatewayJson& gatewayHello) {
+            heartbeatIntervalMs = gatewayHello["d"]["heartbeat_interval"];
+            DEBUG_MSG(std::string("Gateway heartbeat interval: ") + std::to_string(heartbeatIntervalMs) + " ms.");
+            next();
+        }, handler);
+    };
+
+    if (!gatewayConnection) gatewayConnection = std::make_shared<TLSWebSocket>(ioService);
+    if (gatewayConnection->isSocketOpen()) {
+        readHello();
+        return;
+    }
+
+#ifdef HEXICORD_ZLIB_STREAM
+    transportInflate.reset();
+#endif
+    DEBUG_MSG("Performing WebSocket handshake...");
+    gatewayConnection->asyncHandshake(Utils::domainFromUrl(gatewayUrl), gatewayPath(), 443, {},
+        [this, generation, readHello, handler](TLSWebSocket&, boost::system::error_code ec) {
+            if (generation != connectionGeneration) return handler(abortedError());
+            if (ec) return handler(std::make_exception_ptr(boost::system::system_error(ec)));
+
+            // ETF payloads must be sent in binary frames.
+            gatewayConnection->wsStream.binary(encoding_ == Encoding::Etf);
+            readHello();
+        });
+}
+
+void GatewayClient::asyncReadPayload(unsigned generation, std::function<void(GatewayJson&)> next,
+                                     ConnectHandler handler) {
+
+    gatewayConnection->asyncReadMessage([this, generation, next, handler](TLSWebSocket&,
+                                                                          boost::asio::const_buffer body,
+                                                                          boost::system::error_code ec) {
+        if (generation != connectionGeneration) return handler(abortedError());
+        if (ec) return handler(std::make_exception_ptr(boost::system::system_error(ec)));
+
+        GatewayJson message;
+        try {
+            message = parseGatewayMessage(boost::asio::buffer_cast<const uint8_t*>(body),
+                                          boost::asio::buffer_size(body));
+        } catch (...) {
+            return handler(std::current_exception());
+        }
+
+        if (message.is_null()) {
+            // Partial zlib-stream message.
+            asyncReadPayload(generation, next, handler);
+            return;
+        }
+        next(message);
+    });
+}
+
+void GatewayClient::asyncSendPayload(unsigned generation, OpCode code, const nlohmann::json& payload,
+                                     std::function<void()> next, ConnectHandler handler) {
+
+    if (generation != connectionGeneration) return handler(abortedError());
+
+    nlohmann::json message = {
+        { "op", code    },
+        { "d",  payload },
+    };
+
+    sentTimes.push_back(std::chrono::steady_clock::now());
+    gatewayConnection->asyncSendMessage(encodePayload(message), [this, generation, next, handler](TLSWebSocket&,
+                                                                                                  boost::system::error_code ec) {
+        if (generation != connectionGeneration) return handler(abortedError());
+        if (ec) return handler(std::make_exception_ptr(boost::system::system_error(ec)));
+
+        next();
+    });
+}
+
+void GatewayClient::asyncAwaitEvent(unsigned generation, Event type,
+                                    std::function<void(const GatewayJson&)> next, ConnectHandler handler) {
+    skipMessages = true;
+    awaitedEvent = type;
+
+    asyncReadPayload(generation, [this, generation, type, next, handler](GatewayJson& message) {
+        if (message["op"] == OpCode::EventDispatch &&
+            eventEnumFromString(message["t"]) == type) {
+
+            lastSequenceNumber_ = message["s"];
+            skipMessages = false;
+            next(message["d"]);
+            return;
+        }
+
+        try {
+            processMessage(message);
+        } catch (...) {
+            skipMessages = false;
+            return handler(std::current_exception());
+        }
+        asyncAwaitEvent(generation, type, next, handler);
+    }, handler);
 }
 
 void GatewayClient::disconnect(int code) noexcept {
     DEBUG_MSG(std::string("Disconnecting from gateway... code=") + std::to_string(code));
     try {
-        if (code != NoCloseEvent) sendMessage(OpCode::EventDispatch, nlohmann::json(code), "CLOSE");
+        // Can't write while async write is in progress, skip Close event then.
+        if (code != NoCloseEvent && gatewayConnection && !sendInProgress) {
+            sendMessage(OpCode::EventDispatch, nlohmann::json(code), "CLOSE");
+        }
     } catch (...) { // whatever happened - we don't care.
     }
 
+    sendInProgress = false;
+    sendTimer.cancel();
+    sentTimes.clear(); // limit is per connection.
+    {
+        // Other queued messages will be sent after reconnection.
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        for (auto it = sendQueue.begin(); it != sendQueue.end();) {
+            if (it->code == OpCode::Heartbeat) {
+                it = sendQueue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
     heartbeat = false;
     heartbeatTimer.cancel();
+    recoveryTimer.cancel(); // stops scheduled recovery retry.
 
     poll = false;
 
-    gatewayConnection.reset(nullptr);
+    if (gatewayConnection && gatewayConnection.use_count() > 1) {
+        // Handlers of pending reads, writes or handshake hold references
+        // to connection. Abort them, so it's freed once they return
+        // (they see changed connectionGeneration and do nothing).
+        gatewayConnection->abort();
+    }
+    gatewayConnection.reset();
+    ++connectionGeneration; // abort pending asyncConnect/asyncResume.
 
     activeSession = false;
 }
 
-nlohmann::json GatewayClient::waitForEvent(Event type) {
+GatewayJson GatewayClient::waitForEvent(Event type) {
     DEBUG_MSG(std::string("Waiting for event, type=") + std::to_string(unsigned(type)));
     skipMessages = true;
+    awaitedEvent = type;
 
     while (true) {
         lastMessage = {};
@@ -226,6 +627,7 @@ nlohmann::json GatewayClient::waitForEvent(Event type) {
         if (lastMessage["op"] == OpCode::EventDispatch &&
             eventEnumFromString(lastMessage["t"]) == type) {
 
+            lastSequenceNumber_ = lastMessage["s"];
             break;
         } else {
             processMessage(lastMessage);
@@ -238,45 +640,143 @@ nlohmann::json GatewayClient::waitForEvent(Event type) {
 }
 
 void GatewayClient::updatePresence(const nlohmann::json& newPresence) {
-    sendMessage(OpCode::StatusUpdate, newPresence);
+    queueMessage(OpCode::StatusUpdate, newPresence);
+}
+
+void GatewayClient::requestGuildMembers(Snowflake guildId, const std::string& query, unsigned limit) {
+    queueMessage(OpCode::RequestGuildMembers, {
+        { "guild_id", guildId },
+        { "query",    query   },
+        { "limit",    limit   }
+    });
 }
 
 void GatewayClient::recoverConnection() {
     DEBUG_MSG("Lost gateway connection, recovering...");
     disconnect(NoCloseEvent);
+    attemptRecovery(0, true);
+}
 
-    try {
-        resume(lastGatewayUrl_, sessionId_, lastSequenceNumber_, shardId_, shardCount_);
-    } catch (GatewayError& excp) {
-        DEBUG_MSG("Resume failed, starting new session...");
-        connect(lastGatewayUrl_, shardId_, shardCount_, lastPresence);
+void GatewayClient::attemptRecovery(unsigned attempt, bool resumable) {
+    // Copies, because members can be changed before handlers are called.
+    std::string gatewayUrl = lastGatewayUrl_;
+    int shardId = shardId_, shardCount = shardCount_;
+    nlohmann::json presence = lastPresence;
+
+    auto fail = [this, attempt](std::exception_ptr error, bool resumable) {
+        // Exception from Ready/Resumed handler, session itself is fine.
+        // Propagated like exceptions from any other event handler.
+        if (activeSession) std::rethrow_exception(error);
+
+        try {
+            std::rethrow_exception(error);
+        } catch (boost::system::system_error& excp) {
+            // Aborted by disconnect, recovery is not wanted anymore.
+            if (excp.code() == boost::asio::error::operation_aborted) return;
+        } catch (...) {
+        }
+
+        bool willRetry = maxRecoveryAttempts == 0 || attempt + 1 < maxRecoveryAttempts;
+        DEBUG_MSG(std::string("Recovery attempt ") + std::to_string(attempt) + " failed, " +
+                  (willRetry ? "retrying later." : "giving up."));
+
+        // Drop half-open connection, next attempt (or connect) starts from scratch.
+        disconnect(NoCloseEvent);
+
+        if (willRetry) {
+            unsigned delayMs = 1000u << std::min(attempt, 6u);
+            recoveryTimer.expires_from_now(std::chrono::milliseconds(std::min(delayMs, 60000u)));
+            recoveryTimer.async_wait([this, attempt, resumable](const boost::system::error_code& ec) {
+                if (ec == boost::asio::error::operation_aborted) return;
+                attemptRecovery(attempt + 1, resumable);
+            });
+        }
+
+        if (onRecoveryFailure) onRecoveryFailure(error, willRetry);
+    };
+
+    auto connect = [this, fail, gatewayUrl, shardId, shardCount, presence]() {
+        asyncConnect(gatewayUrl, [fail](std::exception_ptr error) {
+            if (error) fail(error, false);
+        }, shardId, shardCount, presence);
+    };
+
+    if (!resumable) {
+        connect();
+        return;
     }
+
+    asyncResume(gatewayUrl, sessionId_, lastSequenceNumber_, [this, fail, connect](std::exception_ptr error) {
+        if (!error) return;
+        try {
+            std::rethrow_exception(error);
+        } catch (GatewayError& excp) {
+            DEBUG_MSG("Resume failed, starting new session...");
+            disconnect(NoCloseEvent);
+            connect();
+            return;
+        } catch (...) {
+        }
+        fail(error, true);
+    }, shardId, shardCount);
 }
 
 void GatewayClient::asyncPoll() {
     assert(activeSession);
 
     DEBUG_MSG("Polling gateway messages...");
-    gatewayConnection->asyncReadMessage([this](TLSWebSocket&, const std::vector<uint8_t>& body,
-                                               boost::system::error_code ec) {
-        if (!poll) return;
-        if (ec == boost::asio::error::broken_pipe ||
-            ec == boost::asio::error::connection_reset ||
-            ec == boost::beast::websocket::error::closed) recoverConnection();
+    unsigned generation = connectionGeneration;
+    gatewayConnection->asyncReadMessage([this, generation](TLSWebSocket&, boost::asio::const_buffer body,
+                                                           boost::system::error_code ec) {
+        // Connection was dropped (and maybe already replaced) by disconnect.
+        if (!poll || generation != connectionGeneration) return;
+        if (ec) {
+            DEBUG_MSG(std::string("Gateway read error: ") + ec.message());
+            recoverConnection();
+            return;
+        }
 
-        try {
-            nlohmann::json message = parseGatewayMessage(body);
+        // Points into connection's read buffer, valid only here.
+        const uint8_t* bodyData = boost::asio::buffer_cast<const uint8_t*>(body);
+        std::size_t bodySize    = boost::asio::buffer_size(body);
 
-            lastMessage = message;
-            if (!skipMessages) processMessage(message);
-        } catch (nlohmann::json::parse_error& excp) {
+        GatewayJson message;
+        try {
+            message = parseGatewayMessage(bodyData, bodySize);
+        } catch (GatewayJson::parse_error& excp) {
             DEBUG_MSG("Corrupted message, assuming connection error, reconnecting...");
             DEBUG_MSG(excp.what());
-            DEBUG_MSG(std::string(body.begin(), body.end()));
+            DEBUG_MSG(std::string(bodyData, bodyData + bodySize));
 
             // we may fail here because of partially readen message (what
             // means gateway dropped our connection).
             recoverConnection();
+            return;
+        } catch (Etf::Error& excp) {
+            DEBUG_MSG("Corrupted ETF message, assuming connection error, reconnecting...");
+            DEBUG_MSG(excp.what());
+
+            recoverConnection();
+            return;
+        }
+#ifdef HEXICORD_ZLIB_STREAM
+        catch (std::runtime_error& excp) {
+            DEBUG_MSG("Corrupted zlib stream, reconnecting...");
+            DEBUG_MSG(excp.what());
+
+            // Inflate context is useless after error, only new connection can help.
+            recoverConnection();
+            return;
+        }
+#endif
+
+        if (!message.is_null()) {
+            // lastMessage is needed only by waitForEvent.
+            if (skipMessages) {
+                lastMessage = std::move(message);
+            } else {
+                processMessage(message);
+            }
         }
 
         if (poll) asyncPoll();
@@ -284,54 +784,19 @@ void GatewayClient::asyncPoll() {
 }
 
 Event GatewayClient::eventEnumFromString(const std::string& str) {
-    static const std::unordered_map<std::string, Event> stringToEnum {
-        { "READY",                          Event::Ready                },
-        { "RESUMED",                        Event::Resumed              },
-        { "CHANNEL_CREATE",                 Event::ChannelCreate        },
-        { "CHANNEL_UPDATE",                 Event::ChannelUpdate        },
-        { "CHANNEL_DELETE",                 Event::ChannelDelete        },
-        { "CHANNEL_PINS_CHANGE",            Event::ChannelPinsChange    },
-        { "GUILD_CREATE",                   Event::GuildCreate          },
-        { "GUILD_UPDATE",                   Event::GuildUpdate          },
-        { "GUILD_DELETE",                   Event::GuildDelete          },
-        { "GUILD_BAN_ADD",                  Event::GuildBanAdd          },
-        { "GUILD_BAN_REMOVE",               Event::GuildBanRemove       },
-        { "GUILD_EMOJIS_UPDATE",            Event::GuildEmojisUpdate    },
-        { "GUILD_INTEGRATIONS_UPDATE",      Event::GuildIntegrationsUpdate },
-        { "GUILD_MEMBER_ADD",               Event::GuildMemberAdd       },
-        { "GUILD_MEMBER_REMOVE",            Event::GuildMemberRemove    },
-        { "GUILD_MEMBER_UPDATE",            Event::GuildMemberUpdate    },
-        { "GUILD_MEMBERS_CHUNK",            Event::GuildMembersChunk    },
-        { "GUILD_ROLE_CREATE",              Event::GuildRoleCreate      },
-        { "GUILD_ROLE_UPDATE",              Event::GuildRoleUpdate      },
-        { "GUILD_ROLE_DELETE",              Event::GuildRoleDelete      },
-        { "MESSAGE_CREATE",                 Event::MessageCreate        },
-        { "MESSAGE_UPDATE",                 Event::MessageUpdate        },
-        { "MESSAGE_DELETE",                 Event::MessageDelete        },
-        { "MESSAGE_DELETE_BULK",            Event::MessageDeleteBulk    },
-        { "MESSAGE_REACTION_ADD",           Event::MessageReactionAdd   },
-        { "MESSAGE_REACTION_REMOVE_ALL",    Event::MessageReactionRemoveAll },
-        { "PRESENCE_UPDATE",                Event::PresenceUpdate       },
-        { "TYPING_START",                   Event::TypingStart          },
-        { "USER_UPDATE",                    Event::UserUpdate           },
-        { "VOICE_STATE_UPDATE",             Event::VoiceStateUpdate     },
-        { "VOICE_SERVER_UPDATE",            Event::VoiceServerUpdate    },
-        { "WEBHOOKS_UPDATE",                Event::WebhooksUpdate       }
-    };
-
-    auto it = stringToEnum.find(str);
-    assert(it != stringToEnum.end());
+    auto it = eventsByName().find(str);
+    assert(it != eventsByName().end());
 
     return it->second;
 }
 
-void GatewayClient::processMessage(const nlohmann::json& message) {
+void GatewayClient::processMessage(GatewayJson& message) {
     switch (message["op"].get<int>()) {
     case OpCode::EventDispatch:
         DEBUG_MSG(std::string("Gateway Event: t=") + message["t"].get<std::string>() +
                   " s=" + std::to_string(message["s"].get<int>()));
         lastSequenceNumber_ = message["s"];
-        eventDispatcher.dispatchEvent(eventEnumFromString(message["t"]), message["d"]);
+        eventDispatcher.dispatchEvent(eventEnumFromString(message["t"]), std::move(message["d"]));
         break;
     case OpCode::HeartbeatAck:
         assert(activeSession);
@@ -341,16 +806,15 @@ void GatewayClient::processMessage(const nlohmann::json& message) {
     case OpCode::Heartbeat:
         assert(activeSession);
         DEBUG_MSG("Received heartbeat request.");
-        sendMessage(OpCode::Heartbeat, nlohmann::json(lastSequenceNumber_));
+        queueMessage(OpCode::Heartbeat, nlohmann::json(lastSequenceNumber_));
         ++unansweredHeartbeats;
         break;
     case OpCode::Reconnect:
         assert(activeSession);
         DEBUG_MSG("Gateway asked us to reconnect...");
-        // It's not recoverConnection duplicate, here Invalid Session error during
-        // resume is real error, not just 'start new session instead'.
+        // Unlike recoverConnection, Close event is sent.
         disconnect();
-        resume(lastGatewayUrl_, sessionId_, lastSequenceNumber_);
+        attemptRecovery(0, true);
         break;
     case OpCode::InvalidSession:
         DEBUG_MSG("Invalid session error.");
@@ -372,8 +836,112 @@ void GatewayClient::sendMessage(GatewayClient::OpCode opCode, const nlohmann::js
         message["t"] = t;
     }
 
-    std::string messageString = message.dump();
-    gatewayConnection->sendMessage(std::vector<uint8_t>(messageString.begin(), messageString.end()));
+    gatewayConnection->sendMessage(encodePayload(message));
+    sentTimes.push_back(std::chrono::steady_clock::now());
+}
+
+void GatewayClient::queueMessage(OpCode code, const nlohmann::json& payload) {
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+
+        auto sameCode = [code](const OutgoingMessage& message) { return message.code == code; };
+
+        if (code == OpCode::Heartbeat) {
+            // Heartbeats go first, only latest sequence number matters.
+            if (!sendQueue.empty() && sendQueue.front().code == OpCode::Heartbeat) {
+                sendQueue.front().payload = payload;
+            } else {
+                sendQueue.push_front({ code, payload });
+            }
+        } else if (code == OpCode::StatusUpdate) {
+            // Only latest presence matters.
+            auto it = std::find_if(sendQueue.begin(), sendQueue.end(), sameCode);
+            if (it != sendQueue.end()) {
+                it->payload = payload;
+            } else {
+                sendQueue.push_back({ code, payload });
+            }
+        } else if (code == OpCode::RequestGuildMembers) {
+            // Gateway accepts array of guilds for same query and limit.
+            auto it = std::find_if(sendQueue.begin(), sendQueue.end(), [&](const OutgoingMessage& message) {
+                return message.code == code &&
+                       message.payload["query"] == payload["query"] &&
+                       message.payload["limit"] == payload["limit"];
+            });
+            if (it != sendQueue.end()) {
+                nlohmann::json& guilds = it->payload["guild_id"];
+                if (!guilds.is_array()) guilds = nlohmann::json::array({ guilds });
+                if (std::find(guilds.begin(), guilds.end(), payload["guild_id"]) == guilds.end()) {
+                    guilds.push_back(payload["guild_id"]);
+                }
+            } else {
+                sendQueue.push_back({ code, payload });
+            }
+        } else {
+            sendQueue.push_back({ code, payload });
+        }
+    }
+
+    ioService.dispatch([this]() { flushSendQueue(); });
+}
+
+unsigned GatewayClient::heartbeatReserve() const {
+    // Heartbeats we send by ourselves plus one for gateway heartbeat requests.
+    if (heartbeatIntervalMs == 0) return 2;
+    return (commandsWindowMs + heartbeatIntervalMs - 1) / heartbeatIntervalMs + 1;
+}
+
+void GatewayClient::flushSendQueue() {
+    if (sendInProgress || !activeSession || !gatewayConnection) return;
+
+    auto now = std::chrono::steady_clock::now();
+    auto window = std::chrono::milliseconds(commandsWindowMs);
+    while (!sentTimes.empty() && now - sentTimes.front() >= window) sentTimes.pop_front();
+
+    OutgoingMessage message;
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        if (sendQueue.empty()) return;
+
+        unsigned limit = commandsLimit;
+        if (sendQueue.front().code != OpCode::Heartbeat) limit -= heartbeatReserve();
+
+        if (sentTimes.size() >= limit) {
+            DEBUG_MSG("Gateway commands limit reached, delaying queued messages...");
+            // Oldest sends leave window one by one, each frees one command.
+            sendTimer.expires_at(sentTimes[sentTimes.size() - limit] + window);
+            sendTimer.async_wait([this](const boost::system::error_code& ec) {
+                if (ec == boost::asio::error::operation_aborted) return;
+                flushSendQueue();
+            });
+            return;
+        }
+
+        message = std::move(sendQueue.front());
+        sendQueue.pop_front();
+    }
+
+    nlohmann::json envelope = {
+        { "op", message.code    },
+        { "d",  message.payload },
+    };
+
+    sentTimes.push_back(now);
+    sendInProgress = true;
+    unsigned generation = connectionGeneration;
+    gatewayConnection->asyncSendMessage(encodePayload(envelope), [this, generation](TLSWebSocket&,
+                                                                                    boost::system::error_code ec) {
+        // Connection is gone, disconnect already reset state.
+        if (generation != connectionGeneration) return;
+
+        sendInProgress = false;
+        if (ec) {
+            // Read side will notice broken connection and recover it.
+            DEBUG_MSG(std::string("Gateway write error: ") + ec.message());
+            return;
+        }
+        flushSendQueue();
+    });
 }
 
 void GatewayClient::asyncHeartbeat() {
@@ -397,8 +965,8 @@ void GatewayClient::sendHeartbeat() {
         return;
     }
 
-    DEBUG_MSG("Gateway heartbeat sent.");
-    sendMessage(OpCode::Heartbeat, nlohmann::json(lastSequenceNumber_));
+    DEBUG_MSG("Gateway heartbeat queued.");
+    queueMessage(OpCode::Heartbeat, nlohmann::json(lastSequenceNumber_));
     ++unansweredHeartbeats;
 }
 
@@ -22,13 +22,25 @@
 #ifndef HEXICORD_GATEWAY_CLIENT_HPP
 #define HEXICORD_GATEWAY_CLIENT_HPP
 
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <hexicord/config.hpp>
 #include <hexicord/json.hpp>
 #include <hexicord/event_dispatcher.hpp>
+#include <hexicord/gateway_json.hpp>
+#include <hexicord/types/snowflake.hpp>
 #include <hexicord/internal/wss.hpp>
+#ifdef HEXICORD_ZLIB_STREAM
+    #include <hexicord/internal/zlib.hpp>
+#endif
 
 namespace Hexicord {
     /**
@@ -52,7 +64,20 @@ namespace Hexicord {
         static constexpr int NoSharding = -1;
         static constexpr int NoCloseEvent = -1;
 
-        GatewayClient(boost::asio::io_service& ioService, const std::string& token);
+        /**
+         * Gateway payloads encoding.
+         *
+         * Etf (Erlang External Term Format) frames are smaller and cheaper
+         * to decode, payloads passed to handlers are same as with Json,
+         * see \ref Etf::decode for details.
+         */
+        enum class Encoding {
+            Json,
+            Etf
+        };
+
+        GatewayClient(boost::asio::io_service& ioService, const std::string& token,
+                      Encoding encoding = Encoding::Json);
         ~GatewayClient();
 
         GatewayClient(const GatewayClient&) = delete;
@@ -133,6 +158,41 @@ namespace Hexicord {
                     std::string sessionId, int lastSequenceNumber,
                     int shardId = NoSharding, int shardCount = NoSharding);
 
+        /**
+         * Called when asynchronous connect or resume finishes, argument
+         * is null on success and contains exception that would be thrown
+         * by synchronous version otherwise.
+         */
+        using ConnectHandler = std::function<void(std::exception_ptr)>;
+
+        /**
+         * Asynchronous version of \ref connect.
+         *
+         * Returns immediately, all steps (resolve, TCP, TLS and WebSocket handshakes,
+         * Hello, Identify, Ready) are performed as I/O service completions, so
+         * connecting client never blocks thread running I/O service.
+         *
+         * handler is invoked from I/O service thread. If \ref disconnect is called
+         * before connection finished, handler receives boost::system::system_error
+         * with operation_aborted code.
+         */
+        void asyncConnect(const std::string& gatewayUrl, ConnectHandler handler,
+                          int shardId = NoSharding, int shardCount = NoSharding,
+                          const nlohmann::json& initialPresence = {{ "game", nullptr },
+                                                                   { "status", "online" },
+                                                                   { "since", nullptr },
+                                                                   { "afk", false }});
+
+        /**
+         * Asynchronous version of \ref resume.
+         *
+         * Same notes as for \ref asyncConnect apply.
+         */
+        void asyncResume(const std::string& gatewayUrl,
+                         std::string sessionId, int lastSequenceNumber,
+                         ConnectHandler handler,
+                         int shardId = NoSharding, int shardCount = NoSharding);
+
         /**
          * Disconnect from gateway with sending Close event
          * with specified code.
@@ -161,13 +221,38 @@ namespace Hexicord {
          * It's better to use async handlers, since behavior of this method is
          * not well defined in all cases.
          */
-        nlohmann::json waitForEvent(Event type);
+        GatewayJson waitForEvent(Event type);
 
         /**
          * Update presence (user status).
+         *
+         * Sent through outbound queue, so returns immediately. If previous
+         * update is still queued (because of rate limit), it's replaced
+         * by this one.
+         *
+         * This method is thread-safe.
          */
         void updatePresence(const nlohmann::json& newPresence);
 
+        /**
+         * Request guild members chunks (received as GuildMembersChunk events),
+         * members with username starting with query are returned, empty string
+         * means all members, limit 0 means no limit.
+         *
+         * Sent through outbound queue. Queued requests with same query and limit
+         * are merged into one request with multiple guilds.
+         *
+         * This method is thread-safe.
+         */
+        void requestGuildMembers(Snowflake guildId, const std::string& query = "", unsigned limit = 0);
+
+        /**
+         * Gateway allows sending at most commandsLimit commands per
+         * commandsWindowMs milliseconds, connection is closed otherwise.
+         */
+        static constexpr unsigned commandsLimit    = 120;
+        static constexpr unsigned commandsWindowMs = 60000;
+
         /**
          * Event dispatcher instance used for gateway
          * event dispatching.
@@ -180,10 +265,42 @@ namespace Hexicord {
          * **Implementation**
          *
          * \ref EventDispatcher::dispatchEvent called by processMessage if
-         * payload contains message.
+         * payload contains message. Payload is moved, so it's not copied
+         * if executor is set (see \ref EventDispatcher::setExecutor).
          */
         EventDispatcher eventDispatcher;
 
+        /**
+         * Called right before sending Identify payload (by \ref connect,
+         * \ref asyncConnect and during connection recovery), if set.
+         * Identify is sent only after hook calls passed function.
+         *
+         * Gateway allows only one Identify per 5 seconds per bot, so when
+         * running several shards hook should delay it (without blocking, for
+         * example using timer) until it's safe to identify.
+         * \ref ShardManager installs such hook on all managed shards.
+         */
+        std::function<void(std::function<void()> proceed)> beforeIdentify;
+
+        /**
+         * Called from I/O service thread when attempt to recover lost
+         * connection (after read error, missed heartbeat answers or Reconnect
+         * request from gateway) fails. error contains exception that caused
+         * failure, it's never thrown from I/O service.
+         *
+         * If willRetry is true, next attempt is made after exponential
+         * backoff (1 second doubled for each attempt, up to 1 minute).
+         * Otherwise client gave up after \ref maxRecoveryAttempts and stays
+         * disconnected until connected again.
+         */
+        std::function<void(std::exception_ptr error, bool willRetry)> onRecoveryFailure;
+
+        /**
+         * Number of failed recovery attempts before giving up, 0 means
+         * retry forever.
+         */
+        unsigned maxRecoveryAttempts = 10;
+
         inline const std::string& token() const {
             return token_;
         }
@@ -199,6 +316,10 @@ namespace Hexicord {
         inline const std::string& lastGatewayUrl() const {
             return lastGatewayUrl_;
         }
+
+        inline Encoding encoding() const {
+            return encoding_;
+        }
 private:
         enum OpCode {
             EventDispatch        = 0,
@@ -215,23 +336,95 @@ private:
             HeartbeatAck         = 11,
         };
 
-        // Disconnect without Close event, try to resume session, if failed - start new session,
-        // if failed - throw InvalidSession.
+        // Disconnect without Close event and start recovery, done asynchronously.
         void recoverConnection();
 
+        // Try to resume session (if resumable), if gateway rejects it - start
+        // new session. Failures are reported to onRecoveryFailure and retried
+        // using recoveryTimer.
+        void attemptRecovery(unsigned attempt, bool resumable);
+        boost::asio::steady_timer recoveryTimer;
+
+        // Building blocks of asyncConnect and asyncResume. Each calls next on
+        // success and handler with error otherwise. generation is value of
+        // connectionGeneration at start of operation, if it changed -
+        // connection is gone and operation is aborted.
+        //
+        // Open connection (if not open) and read Hello.
+        void asyncOpenSession(unsigned generation, const std::string& gatewayUrl,
+                              std::function<void()> next, ConnectHandler handler);
+        // Read one complete payload.
+        void asyncReadPayload(unsigned generation, std::function<void(GatewayJson&)> next,
+                              ConnectHandler handler);
+        void asyncSendPayload(unsigned generation, OpCode code, const nlohmann::json& payload,
+                              std::function<void()> next, ConnectHandler handler);
+        // Asynchronous version of waitForEvent, passes "d" of event to next.
+        void asyncAwaitEvent(unsigned generation, Event type,
+                             std::function<void(const GatewayJson&)> next, ConnectHandler handler);
+        unsigned connectionGeneration = 0; // incremented by disconnect.
+
+        nlohmann::json identifyPayload(int shardId, int shardCount, const nlohmann::json& presence) const;
+
+        // Start heartbeat and polling once Ready or Resumed received.
+        void startSession();
+
         // Poll gateway connection using async read while poll = true, calls
         // processMessage for each message if skipMessages is not set.
         // Saves last received message in lastMessage.
         void asyncPoll();
         bool poll = false, skipMessages = false;
-        nlohmann::json lastMessage;
+        Event awaitedEvent = Event::Ready; // valid only while skipMessages = true.
+        GatewayJson lastMessage;
 
         Event eventEnumFromString(const std::string& str);
 
-        nlohmann::json parseGatewayMessage(const std::vector<uint8_t>& msg);
-        void processMessage(const nlohmann::json& message);
+        // Returns null if message is incomplete (only with zlib-stream, which
+        // may split message across several frames).
+        GatewayJson parseGatewayMessage(const uint8_t* data, std::size_t size);
+        GatewayJson parseGatewayMessage(const std::vector<uint8_t>& msg);
+        // With HEXICORD_ARENA_JSON whole document is allocated from one arena.
+        GatewayJson decodePayload(const uint8_t* payload, std::size_t size) const;
+
+        // Returns false if "d" of dispatch event with this name will not be used
+        // by anyone (no handlers and not waited for) and can be left unparsed.
+        bool isPayloadNeeded(const std::string& eventName) const;
+        std::vector<uint8_t> encodePayload(const nlohmann::json& payload) const;
+
+        // Path and query string for gateway WebSocket handshake.
+        std::string gatewayPath() const;
+        // May move payload out of message.
+        void processMessage(GatewayJson& message);
+
+        // Blocking send, bypasses outbound queue. Used only during handshake
+        // (before polling started) and for Close event.
         void sendMessage(OpCode code, const nlohmann::json& payload = {}, const std::string& t = "");
 
+        // Outbound queue. Messages are sent one by one using async writes
+        // from I/O service thread, while respecting commands rate limit.
+        // Heartbeats are always sent first and have reserved part of limit,
+        // queued presence updates are replaced, member requests are merged.
+        struct OutgoingMessage {
+            OpCode code;
+            nlohmann::json payload;
+        };
+        std::deque<OutgoingMessage> sendQueue; // guarded by sendQueueMutex.
+        std::mutex sendQueueMutex;
+
+        // Thread-safe, actual send happens from I/O service thread.
+        void queueMessage(OpCode code, const nlohmann::json& payload);
+
+        // Send next message from queue if connection is idle and limit
+        // allows it. Called after each completed write and when sendTimer expires.
+        void flushSendQueue();
+
+        // Number of commands left for heartbeats only.
+        unsigned heartbeatReserve() const;
+
+        bool sendInProgress = false;
+        // When last commands were sent, used for rate limiting.
+        std::deque<std::chrono::steady_clock::time_point> sentTimes;
+        boost::asio::steady_timer sendTimer;
+
         // Calls sendHeartbeat every heartbeatIntervalMs milliseconds using
         // heartbeatTimer while heartbeat = true.
         void asyncHeartbeat();
@@ -252,11 +445,18 @@ private:
         int lastSequenceNumber_ = 0;
         nlohmann::json lastPresence;
 
+        Encoding encoding_;
+
 
-        std::unique_ptr<TLSWebSocket> gatewayConnection;
+        // Shared with handlers of pending operations, see TLSWebSocket.
+        std::shared_ptr<TLSWebSocket> gatewayConnection;
         boost::asio::io_service& ioService; // non-owning reference to I/O service.
 
-        static constexpr const char* gatewayPathSuffix = "/?v=6&encoding=json";
+#ifdef HEXICORD_ZLIB_STREAM
+        // Single inflate context for whole connection, reset on (re)connect.
+        Zlib::InflateStream transportInflate;
+        std::vector<uint8_t> inflatedMessage;
+#endif
     };
 }
 
@@ -0,0 +1,99 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_GATEWAY_JSON_HPP
+#define HEXICORD_GATEWAY_JSON_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <hexicord/config.hpp>
+#include <hexicord/json.hpp>
+#ifdef HEXICORD_ARENA_JSON
+    #include <hexicord/internal/arena.hpp>
+#endif
+
+namespace Hexicord {
+#ifdef HEXICORD_ARENA_JSON
+    /**
+     * JSON type of gateway payloads passed to event handlers.
+     *
+     * With HEXICORD_ARENA_JSON enabled, nodes of each received document are
+     * bump-allocated from single arena, which is recycled once document is
+     * destroyed (normally right after dispatch), instead of doing thousands of
+     * small heap allocations. Copies made later, for example if handler
+     * stores part of payload, are allocated from heap as usual.
+     *
+     * Use \ref toJson if you need nlohmann::json.
+     */
+    using GatewayJson = nlohmann::basic_json<std::map, std::vector, std::string, bool,
+                                             std::int64_t, std::uint64_t, double,
+                                             ArenaAllocator>;
+
+    /**
+     * Deep copy of gateway payload as nlohmann::json.
+     */
+    inline nlohmann::json toJson(const GatewayJson& value) {
+        switch (value.type()) {
+        case nlohmann::json::value_t::object: {
+            nlohmann::json result = nlohmann::json::object();
+            for (auto it = value.begin(); it != value.end(); ++it) {
+                result[it.key()] = toJson(it.value());
+            }
+            return result;
+        }
+        case nlohmann::json::value_t::array: {
+            nlohmann::json result = nlohmann::json::array();
+            for (const auto& element : value) {
+                result.push_back(toJson(element));
+            }
+            return result;
+        }
+        case nlohmann::json::value_t::string:
+            return value.get_ref<const std::string&>();
+        case nlohmann::json::value_t::boolean:
+            return value.get<bool>();
+        case nlohmann::json::value_t::number_integer:
+            return value.get<std::int64_t>();
+        case nlohmann::json::value_t::number_unsigned:
+            return value.get<std::uint64_t>();
+        case nlohmann::json::value_t::number_float:
+            return value.get<double>();
+        default:
+            return nullptr;
+        }
+    }
+#else
+    /**
+     * JSON type of gateway payloads passed to event handlers.
+     *
+     * Same as nlohmann::json unless HEXICORD_ARENA_JSON is enabled.
+     */
+    using GatewayJson = nlohmann::json;
+
+    inline const nlohmann::json& toJson(const GatewayJson& value) {
+        return value;
+    }
+#endif
+}
+
+#endif // HEXICORD_GATEWAY_JSON_HPP
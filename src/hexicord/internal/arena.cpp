@@ -0,0 +1,168 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/internal/arena.hpp>
+
+#ifdef HEXICORD_ARENA_JSON
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+
+namespace Hexicord {
+    constexpr std::size_t Arena::minBlockSize;
+    constexpr std::size_t Arena::maxBlockSize;
+    constexpr std::size_t Arena::maxRetainedBlocks;
+    constexpr std::size_t Arena::headerSize;
+
+    // Pool of idle arenas. Never destroyed (as well as arenas kept in it),
+    // because documents may be destroyed during static destruction.
+    // Arenas recycled while pool is full are freed.
+    struct ArenaPool {
+        static constexpr std::size_t maxIdleArenas = 8;
+
+        static ArenaPool& instance() {
+            static ArenaPool* pool = new ArenaPool;
+            return *pool;
+        }
+
+        Arena* acquire() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (idle.empty()) return new Arena;
+
+            Arena* arena = idle.back();
+            idle.pop_back();
+            return arena;
+        }
+
+        void recycle(Arena* arena) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (idle.size() < maxIdleArenas) {
+                    idle.push_back(arena);
+                    return;
+                }
+            }
+            delete arena;
+        }
+
+        std::mutex mutex;
+        std::vector<Arena*> idle;
+    };
+
+namespace {
+    thread_local Arena* currentArena = nullptr;
+
+    inline std::size_t alignSize(std::size_t size) {
+        return (size + 15) & ~std::size_t(15);
+    }
+
+    // Parsed document takes roughly twice as much memory as its text.
+    inline std::size_t firstBlockSize(std::size_t sizeHint) {
+        std::size_t size = sizeHint > Arena::maxBlockSize / 2 ? Arena::maxBlockSize : sizeHint * 2;
+        return std::max(alignSize(size), Arena::minBlockSize);
+    }
+} // anonymous namespace
+
+    void* Arena::allocate(std::size_t size) {
+        std::size_t total = alignSize(size) + headerSize;
+
+        unsigned char* raw;
+        if (currentArena) {
+            raw = static_cast<unsigned char*>(currentArena->allocateHere(total));
+        } else {
+            raw = static_cast<unsigned char*>(::operator new(total));
+        }
+
+        *reinterpret_cast<Arena**>(raw) = currentArena;
+        return raw + headerSize;
+    }
+
+    void Arena::deallocate(void* ptr) noexcept {
+        if (!ptr) return;
+
+        unsigned char* raw = static_cast<unsigned char*>(ptr) - headerSize;
+        Arena* owner = *reinterpret_cast<Arena**>(raw);
+        if (owner) {
+            owner->release();
+        } else {
+            ::operator delete(raw);
+        }
+    }
+
+    void* Arena::allocateHere(std::size_t size) {
+        references.fetch_add(1, std::memory_order_relaxed);
+
+        if (size > maxBlockSize / 4) {
+            largeBlocks.emplace_back(new unsigned char[size]);
+            return largeBlocks.back().get();
+        }
+
+        // Retained blocks may be smaller than needed, skip them.
+        while (currentBlock < blocks.size() && usedInBlock + size > blocks[currentBlock].size) {
+            ++currentBlock;
+            usedInBlock = 0;
+        }
+
+        if (currentBlock == blocks.size()) {
+            std::size_t newBlockSize = std::max(nextBlockSize, size);
+            blocks.push_back(Block{ std::unique_ptr<unsigned char[]>(new unsigned char[newBlockSize]), newBlockSize });
+            nextBlockSize = std::min(nextBlockSize * 2, maxBlockSize);
+            usedInBlock = 0;
+        }
+
+        void* result = blocks[currentBlock].data.get() + usedInBlock;
+        usedInBlock += size;
+        return result;
+    }
+
+    void Arena::release() noexcept {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        reset();
+        ArenaPool::instance().recycle(this);
+    }
+
+    void Arena::reset() noexcept {
+        largeBlocks.clear();
+        if (blocks.size() > maxRetainedBlocks) blocks.erase(blocks.begin() + maxRetainedBlocks, blocks.end());
+        currentBlock  = 0;
+        usedInBlock   = 0;
+        nextBlockSize = minBlockSize;
+    }
+
+    ArenaScope::ArenaScope(std::size_t sizeHint)
+        : arena(ArenaPool::instance().acquire())
+        , previous(currentArena) {
+
+        assert(arena->references == 0);
+        arena->references = 1;
+        arena->nextBlockSize = firstBlockSize(sizeHint);
+        currentArena = arena;
+    }
+
+    ArenaScope::~ArenaScope() {
+        currentArena = previous;
+        arena->release();
+    }
+} // namespace Hexicord
+
+#endif // HEXICORD_ARENA_JSON
@@ -0,0 +1,183 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_ARENA_HPP
+#define HEXICORD_ARENA_HPP
+
+#include <hexicord/config.hpp>
+#ifdef HEXICORD_ARENA_JSON
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ *  \file arena.hpp
+ *  \internal
+ *
+ *  Arena allocation for gateway JSON documents.
+ */
+
+namespace Hexicord {
+    /**
+     *  \internal
+     *
+     *  Bump allocator owning memory of one or more JSON documents.
+     *
+     *  Allocations are done only from thread which owns \ref ArenaScope, but
+     *  can be freed from any thread. Each allocation is prefixed by 16-byte
+     *  header with owning arena (or nullptr for heap allocations), so memory
+     *  from arena and heap can be freely mixed in one document. Once last
+     *  allocation is freed, arena is reset and returned to pool, retaining
+     *  up to maxRetainedBlocks blocks for reuse.
+     *
+     *  First block is sized from expected document size (see \ref ArenaScope),
+     *  each next one is twice as large, up to maxBlockSize.
+     */
+    class Arena {
+    public:
+        static constexpr std::size_t minBlockSize      = 4 * 1024;
+        static constexpr std::size_t maxBlockSize      = 1024 * 1024;
+        static constexpr std::size_t maxRetainedBlocks = 2;
+
+        /**
+         *  \internal
+         *
+         *  Allocate size bytes (aligned to 16) from current thread's arena
+         *  if there is active \ref ArenaScope, from heap otherwise.
+         */
+        static void* allocate(std::size_t size);
+
+        /**
+         *  \internal
+         *
+         *  Free memory returned by \ref allocate.
+         */
+        static void deallocate(void* ptr) noexcept;
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+    private:
+        friend class ArenaScope;
+        friend struct ArenaPool;
+
+        Arena() = default;
+
+        static constexpr std::size_t headerSize = 16;
+
+        struct Block {
+            std::unique_ptr<unsigned char[]> data;
+            std::size_t size;
+        };
+
+        void* allocateHere(std::size_t size);
+
+        // Drop one reference, recycle arena if it was last one.
+        void release() noexcept;
+        void reset() noexcept;
+
+        std::vector<Block> blocks;
+        std::vector<std::unique_ptr<unsigned char[]>> largeBlocks; // allocations larger than maxBlockSize / 4.
+        std::size_t currentBlock = 0, usedInBlock = 0;
+        std::size_t nextBlockSize = minBlockSize; // size of next block allocated from heap.
+
+        // Live allocations plus one for ArenaScope.
+        std::atomic<std::size_t> references { 0 };
+    };
+
+    /**
+     *  \internal
+     *
+     *  Makes arena from pool current for this thread while alive,
+     *  so all \ref ArenaAllocator allocations go to it.
+     *
+     *  sizeHint is size of encoded document, used to pick size of
+     *  arena's first block.
+     */
+    class ArenaScope {
+    public:
+        explicit ArenaScope(std::size_t sizeHint = 0);
+        ~ArenaScope();
+
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+    private:
+        Arena* arena;
+        Arena* previous;
+    };
+
+    /**
+     *  \internal
+     *
+     *  Stateless allocator on top of \ref Arena::allocate, suitable
+     *  as AllocatorType of nlohmann::basic_json.
+     */
+    template<typename T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        template<typename U>
+        struct rebind {
+            using other = ArenaAllocator<U>;
+        };
+
+        ArenaAllocator() noexcept {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+        T* allocate(std::size_t n) {
+            return static_cast<T*>(Arena::allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* ptr, std::size_t) noexcept {
+            Arena::deallocate(ptr);
+        }
+
+        // basic_json calls these directly instead of using allocator_traits.
+        template<typename U, typename... Args>
+        void construct(U* ptr, Args&&... args) {
+            ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+        }
+
+        template<typename U>
+        void destroy(U* ptr) {
+            ptr->~U();
+        }
+    };
+
+    template<typename T, typename U>
+    inline bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept {
+        return true;
+    }
+
+    template<typename T, typename U>
+    inline bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept {
+        return false;
+    }
+} // namespace Hexicord
+
+#endif // HEXICORD_ARENA_JSON
+#endif // HEXICORD_ARENA_HPP
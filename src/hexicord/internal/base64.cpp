@@ -0,0 +1,177 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/internal/utils.hpp>
+
+/**
+ * \file base64.cpp
+ *
+ * Base64 encoder. Input is processed in blocks of 3 bytes (4 characters),
+ * on x86 multiple blocks are encoded at once using SSSE3 or AVX2 if CPU
+ * supports them. Vectorized code translates 6-bit indices to characters
+ * without table lookups, using offsets selected with pshufb (algorithm by
+ * Wojciech Muła).
+ */
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define HEXICORD_BASE64_SIMD 1
+    #include <immintrin.h>
+#endif
+
+namespace Hexicord { namespace Utils {
+namespace {
+    constexpr char base64Map[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    constexpr size_t encodedSize(size_t size) {
+        return ((size + 2) / 3) * 4;
+    }
+
+    // Encodes whole input, returns nothing. Vectorized versions encode
+    // prefix and pass rest to it.
+    void encodeScalar(const uint8_t* input, size_t size, char* output) {
+        for (; size >= 3; size -= 3, input += 3, output += 4) {
+            uint32_t block = (uint32_t(input[0]) << 16) | (uint32_t(input[1]) << 8) | input[2];
+
+            output[0] = base64Map[(block >> 18) & 0x3f];
+            output[1] = base64Map[(block >> 12) & 0x3f];
+            output[2] = base64Map[(block >> 6)  & 0x3f];
+            output[3] = base64Map[ block        & 0x3f];
+        }
+
+        if (size == 0) return;
+
+        // Trailing 1 or 2 bytes, padded with '='.
+        uint32_t block = uint32_t(input[0]) << 16;
+        if (size == 2) block |= uint32_t(input[1]) << 8;
+
+        output[0] = base64Map[(block >> 18) & 0x3f];
+        output[1] = base64Map[(block >> 12) & 0x3f];
+        output[2] = size == 2 ? base64Map[(block >> 6) & 0x3f] : '=';
+        output[3] = '=';
+    }
+
+#ifdef HEXICORD_BASE64_SIMD
+    // Spread 12 bytes (last 4 are ignored) to 16 6-bit indices.
+    __attribute__((target("ssse3")))
+    inline __m128i splitIndices(__m128i input) {
+        input = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+        __m128i t0 = _mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00));
+        __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        __m128i t2 = _mm_and_si128(input, _mm_set1_epi32(0x003f03f0));
+        __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        return _mm_or_si128(t1, t3);
+    }
+
+    // Translate indices to characters by adding offset of their range
+    // (A-Z, a-z, 0-9, '+', '/').
+    __attribute__((target("ssse3")))
+    inline __m128i translateIndices(__m128i indices) {
+        const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                              '/' - 63, 'A', 0, 0);
+
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i less  = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        range = _mm_or_si128(range, _mm_and_si128(less, _mm_set1_epi8(13)));
+        return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+    }
+
+    // Same as above, for each 128-bit lane.
+    __attribute__((target("avx2")))
+    inline __m256i splitIndices(__m256i input) {
+        input = _mm256_shuffle_epi8(input, _mm256_broadcastsi128_si256(
+            _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1)));
+
+        __m256i t0 = _mm256_and_si256(input, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(input, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        return _mm256_or_si256(t1, t3);
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i translateIndices(__m256i indices) {
+        const __m256i offsets = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                          '/' - 63, 'A', 0, 0));
+
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i less  = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        return _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices);
+    }
+
+    __attribute__((target("ssse3")))
+    void encodeSsse3(const uint8_t* input, size_t size, char* output) {
+        // 16 bytes are loaded, but only 12 are used.
+        for (; size >= 16; size -= 12, input += 12, output += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output), translateIndices(splitIndices(block)));
+        }
+        encodeScalar(input, size, output);
+    }
+
+    __attribute__((target("avx2")))
+    void encodeAvx2(const uint8_t* input, size_t size, char* output) {
+        // Two 12-byte blocks, one per lane. Second load reads 16 bytes at
+        // offset 12, so 28 bytes should be available.
+        for (; size >= 28; size -= 24, input += 24, output += 32) {
+            __m256i block = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 12)), 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), translateIndices(splitIndices(block)));
+        }
+        encodeSsse3(input, size, output);
+    }
+#endif // HEXICORD_BASE64_SIMD
+
+    using EncodeFunction = void (*)(const uint8_t*, size_t, char*);
+
+    EncodeFunction selectEncoder() {
+#ifdef HEXICORD_BASE64_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))  return encodeAvx2;
+        if (__builtin_cpu_supports("ssse3")) return encodeSsse3;
+#endif
+        return encodeScalar;
+    }
+} // anonymous namespace
+
+    void base64Encode(const uint8_t* input, size_t size, char* output) {
+        // Selected once, initialization of local static is thread-safe.
+        static const EncodeFunction encode = selectEncoder();
+        encode(input, size, output);
+    }
+
+    void base64Encode(const SharedBuffer& bytes, std::string& output) {
+        size_t offset = output.size();
+        output.resize(offset + encodedSize(bytes.size()));
+        base64Encode(bytes.data(), bytes.size(), &output[offset]);
+    }
+
+    std::string base64Encode(const SharedBuffer& bytes) {
+        std::string result;
+        base64Encode(bytes, result);
+        return result;
+    }
+}} // namespace Hexicord::Utils
@@ -0,0 +1,421 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/internal/etf.hpp>
+
+#include <algorithm>                    // std::min
+#include <cstring>                      // std::memcpy
+#include <cstdlib>                      // std::strtod
+#include <string>                       // std::string, std::to_string
+#include <hexicord/config.hpp>
+#ifdef HEXICORD_ZLIB
+#include <hexicord/internal/zlib.hpp>   // Zlib::decompress
+#endif
+
+namespace Hexicord { namespace Etf {
+namespace {
+    enum Tag : uint8_t {
+        Version           = 131,
+        Compressed        = 80,
+        NewFloat          = 70,
+        SmallInteger      = 97,
+        Integer           = 98,
+        Float             = 99,
+        Atom              = 100,
+        SmallTuple        = 104,
+        LargeTuple        = 105,
+        Nil               = 106,
+        String            = 107,
+        List              = 108,
+        Binary            = 109,
+        SmallBig          = 110,
+        LargeBig          = 111,
+        SmallAtom         = 115,
+        Map               = 116,
+        AtomUtf8          = 118,
+        SmallAtomUtf8     = 119,
+    };
+
+    class Decoder {
+    public:
+        Decoder(const uint8_t* data, std::size_t size) : data(data), size(size) {}
+
+        GatewayJson decodeTerm() {
+            uint8_t tag = read8();
+            switch (tag) {
+            case SmallInteger:  return read8();
+            case Integer:       return int32_t(read32());
+            case NewFloat:      return readNewFloat();
+            case Float:         return std::strtod(readString(31).c_str(), nullptr);
+            case Atom:
+            case AtomUtf8:      return atomToJson(readString(read16()));
+            case SmallAtom:
+            case SmallAtomUtf8: return atomToJson(readString(read8()));
+            case SmallTuple:    return readArray(read8());
+            case LargeTuple:    return readArray(read32());
+            case Nil:           return GatewayJson::array();
+            case String:        return readByteList(read16());
+            case List:          return readList();
+            case Binary:        return readString(read32());
+            case SmallBig:      return readBig(read8());
+            case LargeBig:      return readBig(read32());
+            case Map:           return readMap();
+            default:
+                throw Error(std::string("Unsupported term tag: ") + std::to_string(tag));
+            }
+        }
+
+        // Decode gateway payload envelope. Erlang sorts small map keys, so "d"
+        // usually comes before "t" - values are skipped in first pass to find
+        // "t" and only needed ones are decoded in second.
+        GatewayJson decodeEnvelope(const PayloadFilter& filter) {
+            if (position >= size || data[position] != Map) return decodeTerm();
+            ++position;
+            uint32_t arity = read32();
+
+            std::vector<std::pair<std::string, std::size_t> > fields;
+            // Arity comes from untrusted input, each field takes at least 2 bytes.
+            fields.reserve(std::min<std::size_t>(arity, (size - position) / 2));
+            bool payloadNeeded = true;
+            for (uint32_t i = 0; i < arity; ++i) {
+                GatewayJson key = decodeTerm();
+                fields.emplace_back(key.is_string() ? key.get<std::string>() : key.dump(), position);
+
+                if (fields.back().first == "t") {
+                    GatewayJson eventName = decodeTerm();
+                    if (eventName.is_string()) payloadNeeded = filter(eventName.get_ref<const std::string&>());
+                } else {
+                    skipTerm();
+                }
+            }
+            std::size_t endPosition = position;
+
+            GatewayJson result = GatewayJson::object();
+            for (const auto& field : fields) {
+                if (field.first == "d" && !payloadNeeded) {
+                    result["d"] = nullptr;
+                    continue;
+                }
+                position = field.second;
+                result[field.first] = decodeTerm();
+            }
+            position = endPosition;
+            return result;
+        }
+
+        void skipTerm() {
+            uint8_t tag = read8();
+            switch (tag) {
+            case SmallInteger:  skip(1);                               break;
+            case Integer:       skip(4);                               break;
+            case NewFloat:      skip(8);                               break;
+            case Float:         skip(31);                              break;
+            case Atom:
+            case AtomUtf8:
+            case String:        skip(read16());                        break;
+            case SmallAtom:
+            case SmallAtomUtf8: skip(read8());                         break;
+            case Binary:        skip(read32());                        break;
+            case SmallBig:      skip(std::size_t(read8()) + 1);        break; // + sign byte
+            case LargeBig:      skip(std::size_t(read32()) + 1);       break;
+            case Nil:                                                  break;
+            case SmallTuple:    skipTerms(read8());                    break;
+            case LargeTuple:    skipTerms(read32());                   break;
+            case List:          skipTerms(std::size_t(read32()) + 1);  break; // + tail
+            case Map:           skipTerms(std::size_t(read32()) * 2);  break;
+            default:
+                throw Error(std::string("Unsupported term tag: ") + std::to_string(tag));
+            }
+        }
+
+        bool atEnd() const {
+            return position == size;
+        }
+    private:
+        void skip(std::size_t count) {
+            require(count);
+            position += count;
+        }
+
+        void skipTerms(std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) skipTerm();
+        }
+
+        void require(std::size_t count) const {
+            if (size - position < count) throw Error("Unexpected end of term.");
+        }
+
+        uint8_t read8() {
+            require(1);
+            return data[position++];
+        }
+
+        uint16_t read16() {
+            require(2);
+            uint16_t result = uint16_t(data[position] << 8) | data[position + 1];
+            position += 2;
+            return result;
+        }
+
+        uint32_t read32() {
+            require(4);
+            uint32_t result = (uint32_t(data[position])     << 24) |
+                              (uint32_t(data[position + 1]) << 16) |
+                              (uint32_t(data[position + 2]) << 8)  |
+                               uint32_t(data[position + 3]);
+            position += 4;
+            return result;
+        }
+
+        std::string readString(std::size_t length) {
+            require(length);
+            std::string result(reinterpret_cast<const char*>(data + position), length);
+            position += length;
+            return result;
+        }
+
+        double readNewFloat() {
+            require(8);
+            uint64_t bits = 0;
+            for (unsigned i = 0; i < 8; ++i) bits = (bits << 8) | data[position + i];
+            position += 8;
+
+            double result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+        GatewayJson atomToJson(const std::string& atom) {
+            if (atom == "nil" || atom == "null") return nullptr;
+            if (atom == "true")                  return true;
+            if (atom == "false")                 return false;
+            return atom;
+        }
+
+        GatewayJson readArray(uint32_t arity) {
+            GatewayJson result = GatewayJson::array();
+            for (uint32_t i = 0; i < arity; ++i) {
+                result.push_back(decodeTerm());
+            }
+            return result;
+        }
+
+        // STRING_EXT is how Erlang encodes list of small integers, decoded
+        // as array of numbers (like erlpack does) to match JSON encoding.
+        GatewayJson readByteList(std::size_t length) {
+            require(length);
+            GatewayJson result = GatewayJson::array();
+            for (std::size_t i = 0; i < length; ++i) {
+                result.push_back(unsigned(data[position + i]));
+            }
+            position += length;
+            return result;
+        }
+
+        GatewayJson readList() {
+            GatewayJson result = readArray(read32());
+
+            // Proper lists end with NIL_EXT, improper tail is stored as last element.
+            if (position < size && data[position] == Nil) {
+                ++position;
+            } else {
+                result.push_back(decodeTerm());
+            }
+            return result;
+        }
+
+        GatewayJson readBig(uint32_t digits) {
+            bool negative = read8() != 0;
+            if (digits > 8) throw Error("Big integers longer than 64 bits are not supported.");
+
+            require(digits);
+            uint64_t value = 0;
+            for (uint32_t i = 0; i < digits; ++i) {
+                value |= uint64_t(data[position + i]) << (8 * i);
+            }
+            position += digits;
+
+            // Gateway uses big integers only for snowflakes, which are
+            // strings in JSON encoding.
+            return negative ? "-" + std::to_string(value) : std::to_string(value);
+        }
+
+        GatewayJson readMap() {
+            uint32_t arity = read32();
+
+            GatewayJson result = GatewayJson::object();
+            for (uint32_t i = 0; i < arity; ++i) {
+                GatewayJson key = decodeTerm();
+                std::string keyStr = key.is_string() ? key.get<std::string>() : key.dump();
+                result[keyStr] = decodeTerm();
+            }
+            return result;
+        }
+
+        const uint8_t* data;
+        std::size_t size;
+        std::size_t position = 0;
+    };
+
+    class Encoder {
+    public:
+        void encodeTerm(const nlohmann::json& value) {
+            switch (value.type()) {
+            case nlohmann::json::value_t::null:
+            case nlohmann::json::value_t::discarded:
+                writeAtom("nil");
+                break;
+            case nlohmann::json::value_t::boolean:
+                writeAtom(value.get<bool>() ? "true" : "false");
+                break;
+            case nlohmann::json::value_t::number_unsigned:
+                writeUnsigned(value.get<uint64_t>());
+                break;
+            case nlohmann::json::value_t::number_integer:
+                writeInteger(value.get<int64_t>());
+                break;
+            case nlohmann::json::value_t::number_float:
+                writeFloat(value.get<double>());
+                break;
+            case nlohmann::json::value_t::string:
+                writeBinary(value.get_ref<const std::string&>());
+                break;
+            case nlohmann::json::value_t::array:
+                if (value.empty()) {
+                    buffer.push_back(Nil);
+                    break;
+                }
+                buffer.push_back(List);
+                write32(uint32_t(value.size()));
+                for (const auto& element : value) encodeTerm(element);
+                buffer.push_back(Nil);
+                break;
+            case nlohmann::json::value_t::object:
+                buffer.push_back(Map);
+                write32(uint32_t(value.size()));
+                for (auto it = value.begin(); it != value.end(); ++it) {
+                    writeBinary(it.key());
+                    encodeTerm(it.value());
+                }
+                break;
+            }
+        }
+
+        std::vector<uint8_t> buffer { Version };
+    private:
+        void write32(uint32_t value) {
+            buffer.push_back(uint8_t(value >> 24));
+            buffer.push_back(uint8_t(value >> 16));
+            buffer.push_back(uint8_t(value >> 8));
+            buffer.push_back(uint8_t(value));
+        }
+
+        void writeAtom(const std::string& atom) {
+            buffer.push_back(SmallAtomUtf8);
+            buffer.push_back(uint8_t(atom.size()));
+            buffer.insert(buffer.end(), atom.begin(), atom.end());
+        }
+
+        void writeBinary(const std::string& string) {
+            buffer.push_back(Binary);
+            write32(uint32_t(string.size()));
+            buffer.insert(buffer.end(), string.begin(), string.end());
+        }
+
+        void writeBig(uint64_t magnitude, bool negative) {
+            buffer.push_back(SmallBig);
+            std::size_t digitsPos = buffer.size();
+            buffer.push_back(0);
+            buffer.push_back(negative ? 1 : 0);
+
+            uint8_t digits = 0;
+            while (magnitude != 0) {
+                buffer.push_back(uint8_t(magnitude & 0xFF));
+                magnitude >>= 8;
+                ++digits;
+            }
+            buffer[digitsPos] = digits;
+        }
+
+        void writeUnsigned(uint64_t value) {
+            if (value <= 0xFF) {
+                buffer.push_back(SmallInteger);
+                buffer.push_back(uint8_t(value));
+            } else if (value <= 0x7FFFFFFF) {
+                buffer.push_back(Integer);
+                write32(uint32_t(value));
+            } else {
+                writeBig(value, false);
+            }
+        }
+
+        void writeInteger(int64_t value) {
+            if (value >= 0) {
+                writeUnsigned(uint64_t(value));
+            } else if (value >= INT32_MIN) {
+                buffer.push_back(Integer);
+                write32(uint32_t(int32_t(value)));
+            } else {
+                writeBig(uint64_t(-(value + 1)) + 1, true);
+            }
+        }
+
+        void writeFloat(double value) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            buffer.push_back(NewFloat);
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                buffer.push_back(uint8_t(bits >> shift));
+            }
+        }
+    };
+} // anonymous namespace
+
+GatewayJson decode(const uint8_t* data, std::size_t size, const PayloadFilter& filter) {
+    if (size == 0 || data[0] != Version) throw Error("Missing ETF version byte.");
+
+    if (size > 1 && data[1] == Compressed) {
+#ifdef HEXICORD_ZLIB
+        // Skip uncompressed size, we don't preallocate anyway.
+        if (size < 6) throw Error("Unexpected end of term.");
+
+        std::vector<uint8_t> inflated = Zlib::decompress(std::vector<uint8_t>(data + 6, data + size));
+        Decoder decoder(inflated.data(), inflated.size());
+        return filter ? decoder.decodeEnvelope(filter) : decoder.decodeTerm();
+#else
+        throw Error("Compressed term received but Hexicord is built without zlib.");
+#endif
+    }
+
+    Decoder decoder(data + 1, size - 1);
+    GatewayJson result = filter ? decoder.decodeEnvelope(filter) : decoder.decodeTerm();
+    if (!decoder.atEnd()) throw Error("Trailing data after term.");
+    return result;
+}
+
+std::vector<uint8_t> encode(const nlohmann::json& value) {
+    Encoder encoder;
+    encoder.encodeTerm(value);
+    return encoder.buffer;
+}
+
+}} // namespace Hexicord::Etf
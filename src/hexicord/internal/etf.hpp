@@ -0,0 +1,88 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_ETF_HPP
+#define HEXICORD_ETF_HPP
+
+#include <cstdint>          // uint8_t
+#include <cstddef>          // std::size_t
+#include <vector>           // std::vector
+#include <string>           // std::string
+#include <functional>       // std::function
+#include <stdexcept>        // std::runtime_error
+#include <hexicord/json.hpp>
+#include <hexicord/gateway_json.hpp>
+
+/**
+ *  \file etf.hpp
+ *  \internal
+ *
+ *  Erlang External Term Format codec used for gateway encoding=etf.
+ */
+
+namespace Hexicord { namespace Etf {
+    /**
+     *  \internal
+     *
+     *  Thrown if term is malformed or uses unsupported tag.
+     */
+    struct Error : public std::runtime_error {
+        Error(const std::string& message) : std::runtime_error(message) {}
+    };
+
+    /**
+     *  \internal
+     *
+     *  Called with dispatch event name ("t" field of gateway payload),
+     *  should return false if "d" field is not needed.
+     */
+    using PayloadFilter = std::function<bool(const std::string& eventName)>;
+
+    /**
+     *  \internal
+     *
+     *  Decode term to JSON value in same shape as gateway sends in JSON encoding:
+     *  * atoms nil/null, true, false become null and booleans, other atoms - strings.
+     *  * binaries and strings become strings.
+     *  * lists and tuples become arrays, maps become objects.
+     *  * big integers (snowflakes) become decimal strings, just like IDs in JSON.
+     *
+     *  If filter is passed and top-level term is a map, "t" is decoded first and
+     *  "d" is skipped without decoding (and set to null) if filter returns false.
+     *
+     *  \throws Etf::Error on malformed input.
+     */
+    GatewayJson decode(const uint8_t* data, std::size_t size, const PayloadFilter& filter = nullptr);
+
+    inline GatewayJson decode(const std::vector<uint8_t>& bytes, const PayloadFilter& filter = nullptr) {
+        return decode(bytes.data(), bytes.size(), filter);
+    }
+
+    /**
+     *  \internal
+     *
+     *  Encode JSON value as term. Strings are encoded as binaries, null as
+     *  atom nil and integers not fitting in 32 bits as small big integers.
+     */
+    std::vector<uint8_t> encode(const nlohmann::json& value);
+}} // namespace Hexicord::Etf
+
+#endif // HEXICORD_ETF_HPP
@@ -1,18 +1,149 @@
 #include <hexicord/internal/rest.hpp>
 
 #include <locale>                                   // std::tolower, std::locale
+#include <memory>                                   // std::make_shared
+#include <algorithm>                                // std::remove_if
+#include <limits>                                   // std::numeric_limits
+#include <streambuf>                                // std::streambuf
 #include <boost/asio/ssl/rfc2818_verification.hpp>  // boost::asio::ssl::rfc2818_verification.hpp
 #include <boost/asio/connect.hpp>                   // boost::asio::connect
-#include <boost/beast/http/write.hpp>               // boost::beast::http::write
-#include <boost/beast/http/read.hpp>                // boost::beast::http::read
+#include <boost/beast/http/write.hpp>               // boost::beast::http::write, boost::beast::http::async_write
+#include <boost/beast/http/read.hpp>                // boost::beast::http::read, boost::beast::http::async_read
 #include <boost/beast/http/vector_body.hpp>         // boost::beast::http::vecor_body
+#include <boost/beast/http/empty_body.hpp>          // boost::beast::http::empty_body
+#include <boost/asio/write.hpp>                     // boost::asio::write, boost::asio::async_write
+#include <boost/beast/http/buffer_body.hpp>         // boost::beast::http::buffer_body
+#include <boost/beast/http/parser.hpp>              // boost::beast::http::response_parser
 #include <boost/beast/core/flat_buffer.hpp>         // boost::beast::flat_buffer
 #include <hexicord/internal/utils.hpp>              // Utils::randomAsciiString
 
+#if defined(HEXICORD_DEBUG_LOG)
+    #include <iostream>
+    #define DEBUG_MSG(msg) do { std::cerr <<  "rest.cpp:" << __LINE__ << " " << (msg) << '\n'; } while (false)
+#else
+    #define DEBUG_MSG(msg)
+#endif
+
 namespace ssl = boost::asio::ssl;
 using     tcp = boost::asio::ip::tcp;
 
 namespace Hexicord { namespace REST {
+namespace {
+    // Body is written separately from request fragments, see bodyBuffers.
+    using RawRequest  = boost::beast::http::request<boost::beast::http::empty_body>;
+    using RawResponse = boost::beast::http::response<boost::beast::http::vector_body<uint8_t> >;
+
+    using RawResponseParser = boost::beast::http::response_parser<boost::beast::http::buffer_body>;
+
+    template<typename Fields>
+    void copyHeaders(const Fields& fields, HeadersMap& headers) {
+        for (const auto& header : fields) {
+            headers.insert({ header.name_string().to_string(), header.value().to_string() });
+        }
+    }
+
+    // Response is not used after conversion, so body is moved.
+    HTTPResponse toResponseStruct(RawResponse&& response) {
+        HTTPResponse responseStruct;
+        responseStruct.statusCode = response.result_int();
+        responseStruct.body       = std::move(response.body);
+        copyHeaders(response, responseStruct.headers);
+        return responseStruct;
+    }
+
+    // Reads response body from socket in chunks as it's requested by consumer.
+    class BodyStreamBuf : public std::streambuf {
+    public:
+        BodyStreamBuf(ssl::stream<tcp::socket>& stream, boost::beast::flat_buffer& buffer, RawResponseParser& parser)
+            : stream(stream), buffer(buffer), parser(parser) {}
+
+    protected:
+        int_type underflow() override {
+            while (gptr() == egptr()) {
+                if (parser.is_done()) return traits_type::eof();
+
+                parser.get().body.data = chunk;
+                parser.get().body.size = sizeof(chunk);
+
+                boost::system::error_code ec;
+                boost::beast::http::read(stream, buffer, parser, ec);
+                if (ec == boost::beast::http::error::need_buffer) ec = {};
+                if (ec) throw boost::system::system_error(ec);
+
+                setg(chunk, chunk, chunk + (sizeof(chunk) - parser.get().body.size));
+            }
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+        ssl::stream<tcp::socket>& stream;
+        boost::beast::flat_buffer& buffer;
+        RawResponseParser& parser;
+
+        char chunk[8192];
+    };
+
+    size_t bodySize(const std::vector<SharedBuffer>& body) {
+        size_t size = 0;
+        for (const auto& fragment : body) size += fragment.size();
+        return size;
+    }
+
+    std::vector<boost::asio::const_buffer> bodyBuffers(const std::vector<SharedBuffer>& body) {
+        std::vector<boost::asio::const_buffer> buffers;
+        buffers.reserve(body.size());
+        for (const auto& fragment : body) {
+            if (!fragment.empty()) buffers.emplace_back(fragment.data(), fragment.size());
+        }
+        return buffers;
+    }
+
+    RawRequest prepareRequest(const HTTPRequest& request, const std::string& serverName,
+                              const HeadersMap& connectionHeaders) {
+        RawRequest rawRequest;
+
+        rawRequest.method_string(request.method);
+        rawRequest.target(request.path);
+        rawRequest.version = request.version;
+
+        // Set default headers. 
+        rawRequest.set("User-Agent", "Generic HTTP 1.1 Client");
+        rawRequest.set("Connection", "keep-alive");
+        rawRequest.set("Accept",     "*/*");
+        rawRequest.set("Host",       serverName);
+
+        size_t contentLength = bodySize(request.body);
+        if (contentLength != 0) {
+            rawRequest.set("Content-Type",   "application/octet-stream");
+        }
+
+        // Set per-connection headers.
+        for (const auto& header : connectionHeaders) {
+            rawRequest.set(header.first, header.second);
+        }
+
+        // Set per-request
+        for (const auto& header : request.headers) {
+            rawRequest.set(header.first, header.second);
+        }
+
+        // Sets "Content-Length: 0" for methods that expect body.
+        rawRequest.prepare_payload();
+        if (contentLength != 0) {
+            rawRequest.set("Content-Length", std::to_string(contentLength));
+        }
+        return rawRequest;
+    }
+
+    // Keep-alive connection was closed by server while idle.
+    bool isClosedByRemote(const boost::system::error_code& ec) {
+        return ec == boost::beast::http::error::end_of_stream ||
+               ec == boost::asio::error::eof ||
+               ec == boost::asio::error::broken_pipe ||
+               ec == boost::asio::error::connection_reset;
+    }
+} // anonymous namespace
+
 namespace _detail {
     std::string stringToLower(const std::string& input) {
         std::string result;
@@ -65,69 +196,334 @@ bool HTTPSConnection::isOpen() const {
     return stream.lowest_layer().is_open() && alive;
 }
 
-HTTPResponse HTTPSConnection::request(const HTTPRequest& request) {
-    //
-    // Prepare request
-    //
-    boost::beast::http::request<boost::beast::http::vector_body<uint8_t> > rawRequest;
-    
-    rawRequest.method_string(request.method);
-    rawRequest.target(request.path);
-    rawRequest.version = request.version;
+bool HTTPSConnection::isHealthy() {
+    if (!isOpen()) return false;
 
-    // Set default headers. 
-    rawRequest.set("User-Agent", "Generic HTTP 1.1 Client");
-    rawRequest.set("Connection", "keep-alive");
-    rawRequest.set("Accept",     "*/*");
-    rawRequest.set("Host",       serverName);
-    if (!request.body.empty()) {
-        rawRequest.set("Content-Length", std::to_string(request.body.size()));
-        rawRequest.set("Content-Type",   "application/octet-stream");
-    }
+    // Idle connection should have nothing to read. If remote closed it,
+    // peek returns EOF (or TLS close_notify data).
+    auto& socket = stream.next_layer();
+    boost::system::error_code ec, ignored;
+    uint8_t byte;
 
-    // Set per-connection headers.
-    for (const auto& header : connectionHeaders) {
-        rawRequest.set(header.first, header.second);
-    }
+    socket.non_blocking(true, ec);
+    if (ec) return false;
+    socket.receive(boost::asio::buffer(&byte, 1), tcp::socket::message_peek, ec);
+    socket.non_blocking(false, ignored);
 
-    // Set per-request
-    for (const auto& header : request.headers) {
-        rawRequest.set(header.first, header.second);
-    }
+    return ec == boost::asio::error::would_block;
+}
 
-    if (!request.body.empty()) {
-        rawRequest.body = request.body;
-    }
+HTTPResponse HTTPSConnection::request(const HTTPRequest& request) {
+    RawRequest rawRequest = prepareRequest(request, serverName, connectionHeaders);
 
-    //
-    // Perform request.
-    //
-    
     boost::system::error_code ec;
 
-    rawRequest.prepare_payload();
     alive = false;
     boost::beast::http::write(stream, rawRequest, ec);
     if (ec && ec != boost::beast::http::error::end_of_stream) throw boost::system::system_error(ec);
+    boost::asio::write(stream, bodyBuffers(request.body));
 
-    boost::beast::http::response<boost::beast::http::vector_body<uint8_t> > response;
+    RawResponse response;
     boost::beast::flat_buffer buffer;
     boost::beast::http::read(stream, buffer, response);
 
-    REST::HTTPResponse responseStruct;
-    responseStruct.statusCode = response.result_int();
-    responseStruct.body      = response.body;
-    for (const auto& header : response) {
-        responseStruct.headers.insert({ header.name_string().to_string(), header.value().to_string() });
-    }
     alive = (response["Connection"].to_string() != "close");
     
-    return responseStruct;
+    return toResponseStruct(std::move(response));
+}
+
+HTTPResponse HTTPSConnection::request(const HTTPRequest& request, const BodyReader& reader) {
+    RawRequest rawRequest = prepareRequest(request, serverName, connectionHeaders);
+
+    boost::system::error_code ec;
+
+    alive = false;
+    boost::beast::http::write(stream, rawRequest, ec);
+    if (ec && ec != boost::beast::http::error::end_of_stream) throw boost::system::system_error(ec);
+    boost::asio::write(stream, bodyBuffers(request.body));
+
+    RawResponseParser parser;
+    boost::beast::flat_buffer buffer;
+    boost::beast::http::read_header(stream, buffer, parser);
+
+    HTTPResponse response;
+    response.statusCode = parser.get().result_int();
+    copyHeaders(parser.get(), response.headers);
+
+    BodyStreamBuf bodyBuffer(stream, buffer, parser);
+    std::istream body(&bodyBuffer);
+    body.exceptions(std::ios::badbit); // rethrow socket errors.
+
+    reader(response, body);
+
+    // Skip rest of body, so connection can be reused.
+    body.clear();
+    body.ignore(std::numeric_limits<std::streamsize>::max());
+
+    alive = (parser.get()["Connection"].to_string() != "close");
+
+    return response;
+}
+
+void HTTPSConnection::asyncOpen(AsyncOpenCallback callback) {
+    // Resolver must outlive async_resolve, so it's kept alive by handler.
+    auto resolver = std::make_shared<tcp::resolver>(stream.get_io_service());
+
+    resolver->async_resolve({ serverName, "https" },
+        [this, resolver, callback](boost::system::error_code ec, tcp::resolver::iterator result) {
+        if (ec) return callback(ec);
+        resolutionResult = result;
+
+        boost::asio::async_connect(stream.next_layer(), resolutionResult,
+            [this, callback](boost::system::error_code ec, tcp::resolver::iterator) {
+            if (ec) return callback(ec);
+            stream.next_layer().set_option(tcp::no_delay(true));
+
+            stream.async_handshake(ssl::stream_base::client, [this, callback](boost::system::error_code ec) {
+                if (!ec) alive = true;
+                callback(ec);
+            });
+        });
+    });
+}
+
+void HTTPSConnection::asyncRequest(const HTTPRequest& request, AsyncRequestCallback callback) {
+    // Beast requires message and buffer to be alive until operation completes.
+    struct State {
+        RawRequest request;
+        std::vector<SharedBuffer> body; // keeps fragments referenced by bodyBuffers alive.
+        std::vector<boost::asio::const_buffer> bodyBuffers;
+        RawResponse response;
+        boost::beast::flat_buffer buffer;
+    };
+    auto state = std::make_shared<State>();
+    state->request     = prepareRequest(request, serverName, connectionHeaders);
+    state->body        = request.body;
+    state->bodyBuffers = bodyBuffers(state->body);
+
+    alive = false;
+    boost::beast::http::async_write(stream, state->request, [this, state, callback](boost::system::error_code ec,
+                                                                                     std::size_t) {
+        if (ec && ec != boost::beast::http::error::end_of_stream) return callback({}, ec);
+
+        boost::asio::async_write(stream, state->bodyBuffers, [this, state, callback](boost::system::error_code ec,
+                                                                                      std::size_t) {
+            if (ec) return callback({}, ec);
+
+            boost::beast::http::async_read(stream, state->buffer, state->response,
+                [this, state, callback](boost::system::error_code ec, std::size_t) {
+                if (ec) return callback({}, ec);
+
+                alive = (state->response["Connection"].to_string() != "close");
+                callback(toResponseStruct(std::move(state->response)), ec);
+            });
+        });
+    });
+}
+
+HTTPSConnectionPool::HTTPSConnectionPool(boost::asio::io_service& ioService, const std::string& serverName,
+                                         size_t maxConnections,
+                                         std::chrono::steady_clock::duration idleTimeout)
+    : serverName(serverName)
+    , maxConnections(maxConnections != 0 ? maxConnections : 1)
+    , idleTimeout(idleTimeout)
+    , ioService(ioService)
+    , reapTimer(ioService) {}
+
+HTTPSConnectionPool::~HTTPSConnectionPool() {
+    boost::system::error_code ec;
+    reapTimer.cancel(ec);
+}
+
+void HTTPSConnectionPool::setConnectionHeader(const std::string& name, const std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    connectionHeaders[name] = value;
+}
+
+HTTPResponse HTTPSConnectionPool::request(const HTTPRequest& request) {
+    return performSync([&request](HTTPSConnection& connection) {
+        return connection.request(request);
+    });
+}
+
+HTTPResponse HTTPSConnectionPool::request(const HTTPRequest& request, const HTTPSConnection::BodyReader& reader) {
+    return performSync([&request, &reader](HTTPSConnection& connection) {
+        return connection.request(request, reader);
+    });
+}
+
+HTTPResponse HTTPSConnectionPool::performSync(const std::function<HTTPResponse(HTTPSConnection&)>& perform) {
+    ConnectionPtr connection;
+    HeadersMap headers;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        connection = takeIdle();
+        headers = connectionHeaders;
+        ++active;
+    }
+    bool reused = bool(connection);
+
+    try {
+        if (!connection) {
+            connection = makeConnection();
+            connection->open();
+        }
+        connection->connectionHeaders = headers;
+
+        HTTPResponse response;
+        try {
+            response = perform(*connection);
+        } catch (boost::system::system_error& excp) {
+            if (!reused || !isClosedByRemote(excp.code())) throw;
+
+            DEBUG_MSG("HTTP Connection closed by remote. Reopenning and retrying.");
+            connection = makeConnection();
+            connection->connectionHeaders = headers;
+            connection->open();
+            response = perform(*connection);
+        }
+
+        release(connection);
+        return response;
+    } catch (...) {
+        release(nullptr);
+        throw;
+    }
+}
+
+void HTTPSConnectionPool::asyncRequest(const HTTPRequest& request, HTTPSConnection::AsyncRequestCallback callback) {
+    auto waiter = std::make_shared<Waiter>(Waiter{ request, std::move(callback) });
+
+    ConnectionPtr connection;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (active >= maxConnections) {
+            DEBUG_MSG("All connections are busy, queuing request.");
+            waiters.push_back(std::move(*waiter));
+            return;
+        }
+        connection = takeIdle();
+        ++active;
+    }
+    asyncPerform(connection, bool(connection), waiter);
+}
+
+void HTTPSConnectionPool::asyncPerform(ConnectionPtr connection, bool reused, std::shared_ptr<Waiter> waiter) {
+    if (!connection) {
+        connection = makeConnection();
+        connection->asyncOpen([this, connection, waiter](boost::system::error_code ec) {
+            if (ec) {
+                release(nullptr);
+                return waiter->callback({}, ec);
+            }
+            asyncPerform(connection, false, waiter);
+        });
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        connection->connectionHeaders = connectionHeaders;
+    }
+
+    connection->asyncRequest(waiter->request,
+        [this, connection, reused, waiter](HTTPResponse response, boost::system::error_code ec) {
+        if (ec && reused && isClosedByRemote(ec)) {
+            DEBUG_MSG("HTTP Connection closed by remote. Reopenning and retrying.");
+            return asyncPerform(nullptr, false, waiter);
+        }
+
+        release(ec ? nullptr : connection);
+        waiter->callback(std::move(response), ec);
+    });
+}
+
+void HTTPSConnectionPool::release(ConnectionPtr connection) {
+    std::shared_ptr<Waiter> waiter;
+    ConnectionPtr next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --active;
+
+        if (connection && connection->isOpen() && idle.size() < maxConnections) {
+            idle.push_back({ std::move(connection), std::chrono::steady_clock::now() });
+        }
+
+        if (!waiters.empty() && active < maxConnections) {
+            waiter = std::make_shared<Waiter>(std::move(waiters.front()));
+            waiters.pop_front();
+            next = takeIdle();
+            ++active;
+        }
+
+        if (!idle.empty()) scheduleReap();
+    }
+
+    // Posted, so release called from completion handler don't recurse.
+    if (waiter) {
+        ioService.post([this, next, waiter]() {
+            asyncPerform(next, bool(next), waiter);
+        });
+    }
+}
+
+void HTTPSConnectionPool::reapIdle() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto now = std::chrono::steady_clock::now();
+    idle.erase(std::remove_if(idle.begin(), idle.end(), [this, now](const IdleConnection& entry) {
+        return now - entry.lastUsed >= idleTimeout;
+    }), idle.end());
+
+    if (!idle.empty()) scheduleReap();
+}
+
+size_t HTTPSConnectionPool::idleCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return idle.size();
+}
+
+size_t HTTPSConnectionPool::activeCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return active;
+}
+
+HTTPSConnectionPool::ConnectionPtr HTTPSConnectionPool::takeIdle() {
+    auto now = std::chrono::steady_clock::now();
+    while (!idle.empty()) {
+        IdleConnection entry = std::move(idle.back());
+        idle.pop_back();
+
+        if (now - entry.lastUsed < idleTimeout && entry.connection->isHealthy()) {
+            return entry.connection;
+        }
+        DEBUG_MSG("Dropping stale idle connection.");
+    }
+    return nullptr;
+}
+
+HTTPSConnectionPool::ConnectionPtr HTTPSConnectionPool::makeConnection() {
+    return std::make_shared<HTTPSConnection>(ioService, serverName);
+}
+
+void HTTPSConnectionPool::scheduleReap() {
+    if (reapScheduled) return;
+    reapScheduled = true;
+
+    reapTimer.expires_from_now(idleTimeout);
+    reapTimer.async_wait([this](boost::system::error_code ec) {
+        if (ec == boost::asio::error::operation_aborted) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            reapScheduled = false;
+        }
+        reapIdle();
+    });
 }
 
 HTTPRequest buildMultipartRequest(const std::vector<MultipartEntity>& elements) {
     HTTPRequest request;
-    std::ostringstream oss;
+    std::string fragment;
 
     // XXX: There is some reason for 400 Bad Request coming from Utils::randomAsciiString.
     // std::string boundary = Utils::randomAsciiString(64);
@@ -135,33 +531,36 @@ HTTPRequest buildMultipartRequest(const std::vector<MultipartEntity>& elements)
 
     request.headers["Content-Type"] = std::string("multipart/form-data; boundary=") + boundary;
 
+    // Generated text between entity bodies is collected into fragment,
+    // entity bodies are referenced as is.
+    request.body.reserve(elements.size() * 2 + 1);
     for (auto it = elements.begin(); it != elements.end(); ++it) {
         const auto& element = *it;
 
-        oss << "--" << boundary << "\r\n"
-            << "Content-Disposition: form-data; name=\"" << element.name << "\"";
+        fragment += "--" + boundary + "\r\n" +
+                    "Content-Disposition: form-data; name=\"" + element.name + "\"";
         if (!element.filename.empty()) {
-            oss << "; filename=\"" << element.filename << '"';
+            fragment += "; filename=\"" + element.filename + '"';
         }
-        oss << "\r\n";
+        fragment += "\r\n";
         for (const auto& header : element.additionalHeaders) {
-            oss << header.first << ": " << header.second << "\r\n";
+            fragment += header.first + ": " + header.second + "\r\n";
         }
-        oss << "\r\n";
-        for (uint8_t byte : element.body) {
-            oss << byte;
-        }
-        oss << "\r\n";
+        fragment += "\r\n";
+
+        request.body.emplace_back(std::move(fragment));
+        fragment.clear();
+        request.body.push_back(element.body);
 
-        oss << "--" << boundary;
+        fragment += "\r\n";
+        fragment += "--" + boundary;
         if (it == elements.end() - 1) {
-            oss << "--";
+            fragment += "--";
         }
-        oss << "\r\n";
+        fragment += "\r\n";
     }
+    if (!fragment.empty()) request.body.emplace_back(std::move(fragment));
 
-    std::string resultStr = oss.str();
-    request.body = std::vector<uint8_t>(resultStr.begin(), resultStr.end());
     return request;
 }
 
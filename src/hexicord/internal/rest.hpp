@@ -4,9 +4,17 @@
 #include <string>                     // std::string
 #include <vector>                     // std::vector
 #include <unordered_map>              // std::unordered_map
+#include <functional>                 // std::function
+#include <istream>                    // std::istream
+#include <chrono>                     // std::chrono::steady_clock
+#include <deque>                      // std::deque
+#include <memory>                     // std::shared_ptr
+#include <mutex>                      // std::mutex
+#include <boost/asio/steady_timer.hpp> // boost::asio::steady_timer
 #include <boost/asio/ssl/stream.hpp>  // boost::asio::ssl::stream
 #include <boost/asio/ssl/context.hpp> // boost::asio::ssl::context
 #include <boost/asio/ip/tcp.hpp>      // boost::asio::ip::tcp::socket
+#include <hexicord/types/shared_buffer.hpp> // SharedBuffer
 
 namespace Hexicord { namespace REST {
     namespace _detail {
@@ -34,7 +42,12 @@ namespace Hexicord { namespace REST {
         std::string path;
         
         unsigned version;
-        std::vector<uint8_t> body;
+
+        /**
+         * Body fragments, sent one after another (scatter-gather) without
+         * joining them into single buffer.
+         */
+        std::vector<SharedBuffer> body;
         HeadersMap headers;
     };
 
@@ -47,8 +60,44 @@ namespace Hexicord { namespace REST {
 
         bool isOpen() const;
 
+        /**
+         * Check that connection is open and remote didn't close it while it
+         * was idle (using non-blocking peek, no data is sent).
+         */
+        bool isHealthy();
+
         HTTPResponse request(const HTTPRequest& request);
 
+        /**
+         * Called with status and headers of response (body is empty) and
+         * stream that reads body from socket as it arrives. Part of body not
+         * consumed by reader is skipped. Socket errors are thrown from stream
+         * operations.
+         */
+        using BodyReader = std::function<void(const HTTPResponse& response, std::istream& body)>;
+
+        /**
+         * Perform request passing body to reader instead of storing it in
+         * returned HTTPResponse, so it can be parsed while it's received.
+         */
+        HTTPResponse request(const HTTPRequest& request, const BodyReader& reader);
+
+        using AsyncOpenCallback    = std::function<void(boost::system::error_code)>;
+        using AsyncRequestCallback = std::function<void(HTTPResponse, boost::system::error_code)>;
+
+        /**
+         * Asynchronous version of \ref open. Resolve, TCP connect and TLS
+         * handshake are performed as I/O service completions.
+         */
+        void asyncOpen(AsyncOpenCallback callback);
+
+        /**
+         * Asynchronous version of \ref request. Only one request can be
+         * in progress at a time, connection should not be destroyed
+         * before callback is invoked.
+         */
+        void asyncRequest(const HTTPRequest& request, AsyncRequestCallback callback);
+
         HeadersMap connectionHeaders;
         const std::string serverName;
 
@@ -60,14 +109,112 @@ namespace Hexicord { namespace REST {
         bool alive = false;
     };
 
+    /**
+     * Keep-alive connections to single server.
+     *
+     * Requests are performed using idle connection if any (most recently
+     * used first), new connection is opened otherwise. Idle connections are
+     * checked using \ref HTTPSConnection::isHealthy before reuse and closed
+     * after idleTimeout. If reused connection turns out to be closed by
+     * remote, request is retried once using new connection.
+     *
+     * Asynchronous requests are limited to maxConnections at a time, others
+     * wait for free connection. Synchronous requests never wait (so they
+     * can't deadlock I/O service thread), but connections opened above
+     * limit are closed after use.
+     *
+     * All methods are thread-safe.
+     */
+    class HTTPSConnectionPool {
+    public:
+        HTTPSConnectionPool(boost::asio::io_service& ioService, const std::string& serverName,
+                            size_t maxConnections = 4,
+                            std::chrono::steady_clock::duration idleTimeout = std::chrono::seconds(60));
+
+        ~HTTPSConnectionPool();
+
+        /**
+         * Set header added to all requests.
+         */
+        void setConnectionHeader(const std::string& name, const std::string& value);
+
+        HTTPResponse request(const HTTPRequest& request);
+
+        /**
+         * See \ref HTTPSConnection::request(const HTTPRequest&, const BodyReader&).
+         * Reader may be invoked again if reused connection turns out to be
+         * closed by remote.
+         */
+        HTTPResponse request(const HTTPRequest& request, const HTTPSConnection::BodyReader& reader);
+
+        /**
+         * Callback is invoked from I/O service thread. Pool should not be
+         * destroyed before callback is invoked.
+         */
+        void asyncRequest(const HTTPRequest& request, HTTPSConnection::AsyncRequestCallback callback);
+
+        /**
+         * Close connections idle for longer than idleTimeout. Called
+         * periodically by timer, but can be also called manually.
+         */
+        void reapIdle();
+
+        size_t idleCount() const;
+        size_t activeCount() const;
+
+        const std::string serverName;
+        const size_t maxConnections;
+        const std::chrono::steady_clock::duration idleTimeout;
+    private:
+        using ConnectionPtr = std::shared_ptr<HTTPSConnection>;
+
+        struct IdleConnection {
+            ConnectionPtr connection;
+            std::chrono::steady_clock::time_point lastUsed;
+        };
+
+        struct Waiter {
+            HTTPRequest request;
+            HTTPSConnection::AsyncRequestCallback callback;
+        };
+
+        HTTPResponse performSync(const std::function<HTTPResponse(HTTPSConnection&)>& perform);
+
+        // Following methods expect mutex to be locked.
+        ConnectionPtr takeIdle();
+        void scheduleReap();
+
+        ConnectionPtr makeConnection();
+
+        // Return connection (or nullptr if it's broken) and start waiting request if any.
+        void release(ConnectionPtr connection);
+
+        void asyncPerform(ConnectionPtr connection, bool reused, std::shared_ptr<Waiter> waiter);
+
+        boost::asio::io_service& ioService;
+
+        mutable std::mutex mutex;
+        HeadersMap connectionHeaders;
+        std::vector<IdleConnection> idle; // most recently used at back.
+        std::deque<Waiter> waiters;
+        size_t active = 0;
+
+        boost::asio::steady_timer reapTimer;
+        bool reapScheduled = false;
+    };
+
     struct MultipartEntity {
         std::string name;
         std::string filename;
         HeadersMap additionalHeaders;
 
-        std::vector<uint8_t> body;
+        SharedBuffer body;
     };
 
+    /**
+     * Build multipart/form-data request. Entity bodies are not copied,
+     * request body references them between generated header fragments.
+     */
     HTTPRequest buildMultipartRequest(const std::vector<MultipartEntity>& elements);
 
 }} // namespace Hexicord::REST
@@ -0,0 +1,79 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "route.hpp"
+#include <cstring>      // std::strlen
+
+namespace Hexicord { namespace REST {
+    RouteParameter::RouteParameter(uint64_t id) {
+        // Write digits from the end of buffer.
+        char* end = buffer + sizeof(buffer);
+        char* begin = end;
+        do {
+            *--begin = char('0' + id % 10);
+            id /= 10;
+        } while (id != 0);
+
+        offset = size_t(begin - buffer);
+        size_  = size_t(end - begin);
+    }
+
+    RouteParameter::RouteParameter(const char* str) : external(str), size_(std::strlen(str)) {}
+
+    Route formatRoute(const char* method, const char* pathTemplate, int majorIndex, size_t literalLength,
+                      const RouteParameter* parameters, size_t parametersCount) {
+        Route route;
+        route.method = method;
+
+        size_t parametersLength = 0;
+        for (size_t i = 0; i < parametersCount; ++i) parametersLength += parameters[i].size();
+
+        route.path.reserve(literalLength + parametersLength);
+        route.bucket.reserve(route.method.size() + 1 + std::strlen(pathTemplate) + parametersLength);
+        route.bucket += route.method;
+        route.bucket += ' ';
+
+        int index = 0;
+        for (const char* it = pathTemplate; *it != '\0'; ++it) {
+            if (*it != '{') {
+                route.path   += *it;
+                route.bucket += *it;
+                continue;
+            }
+
+            const char* nameEnd = it;
+            while (*nameEnd != '}') ++nameEnd;
+
+            const RouteParameter& parameter = parameters[index];
+            route.path.append(parameter.data(), parameter.size());
+            if (index == majorIndex) {
+                route.bucket.append(parameter.data(), parameter.size());
+            } else {
+                route.bucket.append(it, nameEnd + 1);
+            }
+
+            it = nameEnd;
+            ++index;
+        }
+
+        return route;
+    }
+}} // namespace Hexicord::REST
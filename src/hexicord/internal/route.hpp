@@ -0,0 +1,158 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_ROUTE_HPP
+#define HEXICORD_ROUTE_HPP
+
+#include <array>                      // std::array
+#include <cstdint>                    // uint64_t
+#include <stdexcept>                  // std::logic_error
+#include <string>                     // std::string
+
+namespace Hexicord { namespace REST {
+    namespace _detail {
+        // C++11 constexpr is limited to single return statement, so these are recursive.
+
+        constexpr unsigned parameterCount(const char* path) {
+            return *path == '\0' ? 0 : (*path == '{' ? 1 : 0) + parameterCount(path + 1);
+        }
+
+        constexpr size_t literalLength(const char* path, bool inParameter = false) {
+            return *path == '\0' ? 0 :
+                   *path == '{'  ? literalLength(path + 1, true) :
+                   *path == '}'  ? literalLength(path + 1, false) :
+                                   (inParameter ? 0 : 1) + literalLength(path + 1, inParameter);
+        }
+
+        constexpr bool wellFormed(const char* path, bool inParameter = false) {
+            return *path == '\0' ? !inParameter :
+                   *path == '{'  ? !inParameter && wellFormed(path + 1, true) :
+                   *path == '}'  ? inParameter && wellFormed(path + 1, false) :
+                                   wellFormed(path + 1, inParameter);
+        }
+
+        constexpr bool startsWith(const char* str, const char* prefix) {
+            return *prefix == '\0' || (*str == *prefix && startsWith(str + 1, prefix + 1));
+        }
+
+        // Parameters that have their own rate limits, see
+        // https://discordapp.com/developers/docs/topics/rate-limits
+        constexpr bool isMajorName(const char* name) {
+            return startsWith(name, "channel}") || startsWith(name, "guild}") || startsWith(name, "webhook}");
+        }
+
+        // Index of first major parameter or -1 if there is none.
+        constexpr int majorIndex(const char* path, int index = 0) {
+            return *path == '\0' ? -1 :
+                   *path != '{'  ? majorIndex(path + 1, index) :
+                   isMajorName(path + 1) ? index : majorIndex(path + 1, index + 1);
+        }
+
+        constexpr const char* checkedPath(const char* path, unsigned expectedParameters) {
+            return !wellFormed(path) ? throw std::logic_error("Unbalanced braces in route template") :
+                   parameterCount(path) != expectedParameters ? throw std::logic_error("Wrong route parameters count") :
+                   path;
+        }
+    } // namespace _detail
+
+    /**
+     * Route with parameters substituted.
+     */
+    struct Route {
+        std::string method;
+
+        /// Path relative to API base, without query string.
+        std::string path;
+
+        /**
+         * Rate-limit bucket key: method and route template with major
+         * parameters substituted ("DELETE /channels/1234/messages/{message}").
+         */
+        std::string bucket;
+    };
+
+    /**
+     * Route parameter converted to text without allocation.
+     *
+     * Text of numeric parameter is stored inside object and referenced
+     * by offset, so copies are safe.
+     */
+    class RouteParameter {
+    public:
+        RouteParameter(uint64_t id);
+        RouteParameter(const std::string& str) : external(str.data()), size_(str.size()) {}
+        RouteParameter(const char* str);
+
+        const char* data() const { return external ? external : buffer + offset; }
+        size_t size() const { return size_; }
+    private:
+        char buffer[20]; // enough for any uint64_t.
+        const char* external = nullptr; // nullptr if text is in buffer.
+        size_t offset = 0;
+        size_t size_;
+    };
+
+    /**
+     * \internal
+     *
+     * Substitute parameters into template, writes path and bucket key.
+     */
+    Route formatRoute(const char* method, const char* pathTemplate, int majorIndex, size_t literalLength,
+                      const RouteParameter* parameters, size_t parametersCount);
+
+    /**
+     * Route template like "/channels/{channel}/messages/{message}".
+     *
+     * Template is checked at compile time if declared as constexpr: braces
+     * should be balanced and number of parameters should match
+     * ParametersCount. {channel}, {guild} and {webhook} are major parameters
+     * (only first one is used), other parameters are not included in bucket key.
+     *
+     * \code
+     * constexpr REST::RouteTemplate<2> getMessage("GET", "/channels/{channel}/messages/{message}");
+     * restClient.sendRestRequest(getMessage.format(channelId, messageId));
+     * \endcode
+     */
+    template<unsigned ParametersCount>
+    class RouteTemplate {
+    public:
+        constexpr RouteTemplate(const char* method, const char* path)
+            : method(method)
+            , path(_detail::checkedPath(path, ParametersCount))
+            , majorIndex(_detail::majorIndex(path))
+            , literalLength(_detail::literalLength(path)) {}
+
+        template<typename... Params>
+        Route format(const Params&... params) const {
+            static_assert(sizeof...(Params) == ParametersCount, "Wrong number of route parameters");
+
+            const std::array<RouteParameter, ParametersCount> converted {{ RouteParameter(params)... }};
+            return formatRoute(method, path, majorIndex, literalLength, converted.data(), converted.size());
+        }
+
+        const char* const method;
+        const char* const path;
+        const int majorIndex;
+        const size_t literalLength;
+    };
+}} // namespace Hexicord::REST
+
+#endif // HEXICORD_ROUTE_HPP
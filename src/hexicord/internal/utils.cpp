@@ -21,17 +21,17 @@
 
 #include "utils.hpp"
 #include <iterator>     // std::back_inserter
-#include <algorithm>    // std::copy
-#include <cctype>       // std::isalnum
+#include <algorithm>    // std::copy, std::find_if
+#include <cctype>       // std::isalnum, std::isdigit
 #include <stdexcept>    // std::invalid_argument
-#include <cassert>      // assert
 #include <sstream>      // std::ostringstream
 #include <iomanip>      // std::setw
 #include <cstdlib>      // std::rand, std::rand
+#include <cstdio>       // std::sscanf
 
 namespace Hexicord { namespace Utils {
     namespace Magic {
-        bool isGif(const std::vector<uint8_t>& bytes) {
+        bool isGif(const SharedBuffer& bytes) {
             // according to http://fileformats.archiveteam.org/wiki/GIF
             return bytes.size() >= 6 &&  // TODO: check against minimal headers size
                 bytes[0] == 'G' &&  // should begin with 'GIF'
@@ -50,7 +50,7 @@ namespace Hexicord { namespace Utils {
                 ); 
         }
 
-        bool isJfif(const std::vector<uint8_t>& bytes) {
+        bool isJfif(const SharedBuffer& bytes) {
             // according to http://fileformats.archiveteam.org/wiki/JFIF
             return bytes.size() >= 3 && // TODO: check against minimal headers size
                 bytes[0] == 0xFF &&
@@ -58,7 +58,7 @@ namespace Hexicord { namespace Utils {
                 bytes[2] == 0xFF;
         }
 
-        bool isPng(const std::vector<uint8_t>& bytes) {
+        bool isPng(const SharedBuffer& bytes) {
             // according to https://www.w3.org/TR/PNG/#5PNG-file-signature
             return bytes.size() >= 12 && // signature + single no-data chunk size
                 bytes[0] == 137 &&
@@ -71,7 +71,7 @@ namespace Hexicord { namespace Utils {
                 bytes[7] == 10;    // LF
         }
 
-        bool isWebp(const std::vector<uint8_t>& bytes) {
+        bool isWebp(const SharedBuffer& bytes) {
             // according to https://developers.google.com/speed/webp/docs/riff_container?csw=1
             return bytes.size() >= 12 && // 'RIFF' + size + 'WEBP'
                 bytes[0]  == 'R' &&
@@ -141,34 +141,6 @@ namespace Hexicord { namespace Utils {
 	   return result;
 	}
 
-	std::string base64Encode(const std::vector<uint8_t>& data)
-	{
-	   static constexpr uint8_t base64Map[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-	   // Use = signs so the end is properly padded.
-	   std::string result((((data.size() + 2) / 3) * 4), '=');
-	   size_t outpos = 0;
-	   int bits_collected = 0;
-	   unsigned accumulator = 0;
-
-	   for (uint8_t byte : data) {
-	      accumulator = (accumulator << 8) | (byte & 0xffu);
-	      bits_collected += 8;
-	      while (bits_collected >= 6) {
-	         bits_collected -= 6;
-	         result[outpos++] = base64Map[(accumulator >> bits_collected) & 0x3fu];
-	      }
-	   }
-	   if (bits_collected > 0) { // Any trailing bits that are missing.
-	      assert(bits_collected < 6);
-	      accumulator <<= 6 - bits_collected;
-	      result[outpos++] = base64Map[accumulator & 0x3fu];
-	   }
-	   assert(outpos >= (result.size() - 2));
-	   assert(outpos <= result.size());
-	   return result;
-	}
-
     std::string urlEncode(const std::string& raw) {
         std::ostringstream resultStream;
 
@@ -246,6 +218,65 @@ namespace Hexicord { namespace Utils {
         return ratelimitDomain;
     }
 
+    namespace {
+        // Days since 1970-01-01 in proleptic Gregorian calendar,
+        // see http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+        long long daysFromCivil(int year, int month, int day) {
+            int y = month <= 2 ? year - 1 : year;
+            int era = (y >= 0 ? y : y - 399) / 400;
+            unsigned yearOfEra   = unsigned(y - era * 400);
+            unsigned dayOfYear   = (153 * unsigned(month > 2 ? month - 3 : month + 9) + 2) / 5 + unsigned(day) - 1;
+            unsigned dayOfEra    = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+            return era * 146097LL + dayOfEra - 719468;
+        }
+    } // anonymous namespace
+
+    time_t parseIso8601(const std::string& timestamp) {
+        int year, month, day, hour, minute, second;
+        if (std::sscanf(timestamp.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d",
+                        &year, &month, &day, &hour, &minute, &second) != 6) {
+            return 0;
+        }
+        if (month < 1 || month > 12 || day < 1 || day > 31) return 0;
+
+        long long result = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+
+        // Skip fractional part and apply offset (if any).
+        size_t pos = 19;
+        if (pos < timestamp.size() && timestamp[pos] == '.') {
+            ++pos;
+            while (pos < timestamp.size() && std::isdigit(static_cast<unsigned char>(timestamp[pos]))) ++pos;
+        }
+        if (pos < timestamp.size() && (timestamp[pos] == '+' || timestamp[pos] == '-')) {
+            int offsetHours = 0, offsetMinutes = 0;
+            std::sscanf(timestamp.c_str() + pos + 1, "%2d:%2d", &offsetHours, &offsetMinutes);
+            long long offset = offsetHours * 3600 + offsetMinutes * 60;
+            result += timestamp[pos] == '+' ? -offset : offset;
+        }
+
+        return time_t(result);
+    }
+
+    time_t parseHttpDate(const std::string& date) {
+        static const char* const monthNames[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+        char monthName[4] = {};
+        int year, day, hour, minute, second;
+        if (std::sscanf(date.c_str(), "%*3s, %2d %3s %4d %2d:%2d:%2d",
+                        &day, monthName, &year, &hour, &minute, &second) != 6) {
+            return 0;
+        }
+
+        auto monthIt = std::find_if(std::begin(monthNames), std::end(monthNames), [&monthName](const char* name) {
+            return std::string(name) == monthName;
+        });
+        if (monthIt == std::end(monthNames) || day < 1 || day > 31) return 0;
+        int month = int(monthIt - std::begin(monthNames)) + 1;
+
+        return time_t(daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second);
+    }
+
     RandomSeedGuard::RandomSeedGuard() {
         static bool randomSeeded = false;
         if (!randomSeeded) std::srand(std::time(nullptr));
@@ -26,6 +26,8 @@
 #include <string>
 #include <istream>
 #include <unordered_map>
+#include <ctime>
+#include <hexicord/types/shared_buffer.hpp>
 
 /**
  *  Reusable code snippets.
@@ -36,10 +38,10 @@ namespace Hexicord { namespace Utils {
      *  Fast but in-percise type identification based on first ("magic") bytes.
      */
     namespace Magic {
-        bool isGif(const std::vector<uint8_t>& bytes);
-        bool isJfif(const std::vector<uint8_t>& bytes);
-        bool isPng(const std::vector<uint8_t>& bytes);
-        bool isWebp(const std::vector<uint8_t>& bytes);
+        bool isGif(const SharedBuffer& bytes);
+        bool isJfif(const SharedBuffer& bytes);
+        bool isPng(const SharedBuffer& bytes);
+        bool isWebp(const SharedBuffer& bytes);
     }
 
     /**
@@ -50,7 +52,20 @@ namespace Hexicord { namespace Utils {
     /**
      *  Encode arbitrary data using base64.
      */
-    std::string base64Encode(const std::vector<uint8_t>& bytes);
+    std::string base64Encode(const SharedBuffer& bytes);
+
+    /**
+     *  Encode bytes using base64 and append result to output, so strings
+     *  like data URIs can be built without temporary copies.
+     */
+    void base64Encode(const SharedBuffer& bytes, std::string& output);
+
+    /**
+     *  Encode size bytes from input, writing ((size + 2) / 3) * 4 characters
+     *  (including padding) to output. AVX2 or SSSE3 is used if supported
+     *  by CPU (detected at runtime).
+     */
+    void base64Encode(const uint8_t* input, size_t size, char* output);
 
     std::string urlEncode(const std::string& raw);
     std::string makeQueryString(const std::unordered_map<std::string, std::string>& queryVariables);
@@ -61,9 +76,28 @@ namespace Hexicord { namespace Utils {
 
     /**
      * Extract part of URL that have "per-route" ratelimit.
+     *
+     * Used only for raw requests, routes formatted from REST::RouteTemplate
+     * already know their bucket.
      */
     std::string getRatelimitDomain(const std::string& path);
 
+    /**
+     * Parse ISO 8601 timestamp as sent by Discord ("2017-08-20T15:20:50.123000+00:00")
+     * into Unix time. Fractional seconds are ignored, timezone offset is applied.
+     *
+     * \returns 0 if timestamp is malformed.
+     */
+    time_t parseIso8601(const std::string& timestamp);
+
+    /**
+     * Parse HTTP date as sent in Date header ("Sun, 06 Nov 1994 08:49:37 GMT")
+     * into Unix time.
+     *
+     * \returns 0 if date is malformed.
+     */
+    time_t parseHttpDate(const std::string& date);
+
     // Construct it somewhere to make sure PRNG is initialized.
     struct RandomSeedGuard { RandomSeedGuard(); };
 
@@ -59,25 +59,30 @@ namespace Hexicord {
     }
 
     void TLSWebSocket::asyncReadMessage(TLSWebSocket::AsyncReadCallback callback) {
-        std::shared_ptr<boost::beast::flat_buffer> buffer(new boost::beast::flat_buffer);
+        readBuffer.consume(readBuffer.size()); // keeps capacity.
 
-        wsStream.async_read(*buffer, [this, buffer, callback](boost::system::error_code ec, unsigned long length) {
-            // buffer captured by value into lambda.
-            // so they will exist here and hold ownership.
-        
-            auto bufferData = boost::asio::buffer_cast<const uint8_t*>(*buffer->data().begin());
-            std::vector<uint8_t> vectorBuffer(bufferData, bufferData + length);
+        // Handler holds reference, so readBuffer is alive even if owner
+        // dropped connection while read was pending.
+        auto self = shared_from_this();
 
-            callback(*this, vectorBuffer, ec);
+        wsStream.async_read(readBuffer, [self, callback](boost::system::error_code ec, unsigned long length) {
+            // Buffer contents are meaningless after error (including abort).
+            if (ec) return callback(*self, boost::asio::const_buffer(), ec);
 
-            // however, buffer ownership will be released here and it will
-            // removed. 
+            auto bufferData = boost::asio::buffer_cast<const uint8_t*>(*self->readBuffer.data().begin());
+
+            callback(*self, boost::asio::const_buffer(bufferData, length), ec);
         });
     }
 
     void TLSWebSocket::asyncSendMessage(const std::vector<uint8_t>& message, TLSWebSocket::AsyncSendCallback callback) {
-        wsStream.async_write(boost::asio::buffer(message.data(), message.size()), [this, callback] (boost::system::error_code ec) {
-            callback(*this, ec);
+        // Buffer should live until write completion.
+        auto messageCopy = std::make_shared<std::vector<uint8_t>>(message);
+
+        auto self = shared_from_this();
+
+        wsStream.async_write(boost::asio::buffer(messageCopy->data(), messageCopy->size()), [self, messageCopy, callback] (boost::system::error_code ec) {
+            callback(*self, ec);
         });
     }
 
@@ -96,6 +101,46 @@ namespace Hexicord {
         });
     }
 
+    void TLSWebSocket::asyncHandshake(const std::string& servername, const std::string& path, unsigned short port,
+                                      const std::unordered_map<std::string, std::string>& additionalHeaders,
+                                      TLSWebSocket::AsyncHandshakeCallback callback) {
+
+        // Resolver must outlive async_resolve, so it's kept alive by handler.
+        auto resolver = std::make_shared<tcp::resolver>(wsStream.get_io_service());
+        // Each step holds reference to connection, so owner can drop it at any time.
+        auto self = shared_from_this();
+        aborted = false;
+
+        resolver->async_resolve({ servername, std::to_string(port) },
+            [self, resolver, servername, path, additionalHeaders, callback](boost::system::error_code ec,
+                                                                           tcp::resolver::iterator result) {
+            if (!ec && self->aborted) ec = boost::asio::error::operation_aborted;
+            if (ec) return callback(*self, ec);
+            self->resolutionResult = result;
+
+            boost::asio::async_connect(self->wsStream.lowest_layer(), self->resolutionResult,
+                [self, servername, path, additionalHeaders, callback](boost::system::error_code ec,
+                                                                     tcp::resolver::iterator) {
+                if (!ec && self->aborted) ec = boost::asio::error::operation_aborted;
+                if (ec) return callback(*self, ec);
+
+                self->wsStream.next_layer().async_handshake(ssl::stream_base::client,
+                    [self, servername, path, additionalHeaders, callback](boost::system::error_code ec) {
+                    if (!ec && self->aborted) ec = boost::asio::error::operation_aborted;
+                    if (ec) return callback(*self, ec);
+
+                    self->wsStream.async_handshake_ex(servername, path, [&additionalHeaders](websocket::request_type& request) {
+                        for (const auto& header : additionalHeaders) {
+                            request.set(header.first, header.second);
+                        }
+                    }, [self, callback](boost::system::error_code ec) {
+                        callback(*self, ec);
+                    });
+                });
+            });
+        });
+    }
+
     void TLSWebSocket::shutdown(websocket::close_code reason) {
         std::lock_guard<std::mutex> lock(connectionMutex);
 
@@ -113,4 +158,12 @@ namespace Hexicord {
         wsStream.next_layer().shutdown(/* ignored */ ec);
         wsStream.next_layer().next_layer().close();
     }
+
+    void TLSWebSocket::abort() {
+        // Not locked: it's allowed to interrupt blocking operation in other thread.
+        aborted = true;
+
+        boost::system::error_code ignored;
+        wsStream.lowest_layer().close(ignored);
+    }
 } // namespace Hexicord
@@ -23,10 +23,12 @@
 #define HEXICORD_WSS_HPP
 
 #include <string>                       // std::string
+#include <unordered_map>                // std::unordered_map
 #include <vector>                       // std::vector
 #include <memory>                       // std::enable_shared_from_this
 #include <mutex>                        // std::mutex, std::lock_guard
 #include <boost/beast/core/error.hpp>         // boost::system::error_code, boost::system::system_error 
+#include <boost/beast/core/flat_buffer.hpp>   // flat_buffer
 #include <boost/beast/websocket/stream.hpp>   // websocket::stream
 #include <boost/beast/websocket/ssl.hpp>      // required to use ssl::stream beyond websocket
 #include <boost/asio/ip/tcp.hpp>        // tcp::socket, tcp::resolver::iterator 
@@ -50,15 +52,28 @@ namespace Hexicord {
      *
      *  High-level beast WebSockets wrapper. Provides basic I/O operations:
      *  read, send, async read, async write.
+     *
+     *  Handlers of asynchronous operations hold std::shared_ptr to
+     *  connection, so it's destroyed only after all of them are invoked.
+     *  Owner should call \ref abort before dropping its reference if
+     *  operations are pending, otherwise they keep connection alive until
+     *  they complete by themselves.
      */
-    class TLSWebSocket : std::enable_shared_from_this<TLSWebSocket> {
+    class TLSWebSocket : public std::enable_shared_from_this<TLSWebSocket> {
         using TLSStream = ssl::stream<boost::asio::ip::tcp::socket>;
         using WSSStream = websocket::stream<TLSStream>;
         using IOService = boost::asio::io_service;
         using tcp = boost::asio::ip::tcp;
     public:
-        using AsyncReadCallback = std::function<void(TLSWebSocket&, const std::vector<uint8_t>&, boost::system::error_code)>;
+        /**
+         *  \internal
+         *
+         *  Message passed as view of internal read buffer, it's valid only
+         *  until callback returns.
+         */
+        using AsyncReadCallback = std::function<void(TLSWebSocket&, boost::asio::const_buffer, boost::system::error_code)>;
         using AsyncSendCallback = std::function<void(TLSWebSocket&, boost::system::error_code)>;
+        using AsyncHandshakeCallback = std::function<void(TLSWebSocket&, boost::system::error_code)>;
 
         /**
          *  \internal
@@ -100,6 +115,8 @@ namespace Hexicord {
          *  \internal
          *
          *  Asynchronously read message and call callback when done (or error occured).
+         *  Single read buffer is reused for all messages, so no allocations
+         *  are done once it grown to fit largest message.
          *
          *  \warning For now there is no way to cancel this operation.
          *  \warning TLSWebSocket *MUST* be allocated in heap and stored
@@ -114,6 +131,7 @@ namespace Hexicord {
          *  \internal
          *
          *  Asynchronusly send message and call callback when done (or error occured).
+         *  Message is copied, so caller don't have to keep it alive.
          *
          *  \warning For now there is no way to cancel this operation.
          *  \warning TLSWebSocket *MUST* be allocated in heap and stored
@@ -135,6 +153,21 @@ namespace Hexicord {
          */
         void handshake(const std::string& servername, const std::string& path, unsigned short port = 443, const std::unordered_map<std::string, std::string>& additionalHeaders = {});
 
+        /**
+         *  \internal
+         *
+         *  Asynchronous version of \ref handshake, calls callback when
+         *  all three handshakes are done (or error occured).
+         *
+         *  \warning TLSWebSocket *MUST* be allocated in heap and stored
+         *          in std::shared_ptr for this function to work correctly.
+         *
+         *  This method is NOT thread-safe.
+         */
+        void asyncHandshake(const std::string& servername, const std::string& path, unsigned short port,
+                            const std::unordered_map<std::string, std::string>& additionalHeaders,
+                            AsyncHandshakeCallback callback);
+
         /**
          *  \internal
          *
@@ -146,6 +179,15 @@ namespace Hexicord {
          */
         void shutdown(websocket::close_code reason = websocket::close_code::normal);
 
+        /**
+         *  \internal
+         *
+         *  Close socket without WebSocket closing handshake. Pending
+         *  asynchronous operations (including remaining handshake steps)
+         *  complete with error, usually operation_aborted.
+         */
+        void abort();
+
         bool isSocketOpen() const {
             return wsStream.lowest_layer().is_open();
         }
@@ -155,6 +197,14 @@ namespace Hexicord {
     private:
         tcp::resolver::iterator resolutionResult;
 
+        // Set by abort, checked between asyncHandshake steps so aborted
+        // handshake don't reopen socket.
+        bool aborted = false;
+
+        // Used by asyncReadMessage, cleared before each read (not after, because
+        // callback is allowed to drop last reference to TLSWebSocket).
+        boost::beast::flat_buffer readBuffer;
+
         const std::string servername;
         std::mutex connectionMutex;
     };
@@ -25,6 +25,7 @@
 #include <cstring>
 #include <cassert>
 #include <string>
+#include <stdexcept>
 #include <zlib.h>
 
 // Closer to trivial message size => better.
@@ -71,6 +72,67 @@ namespace Zlib {
         inflateEnd(&stream);
         return result;
     }
+
+    InflateStream::InflateStream() : stream(new z_stream) {
+        stream->zalloc = Z_NULL;
+        stream->zfree = Z_NULL;
+        stream->opaque = Z_NULL;
+        stream->avail_in = 0;
+        stream->next_in = Z_NULL;
+
+        int status = inflateInit2(stream.get(), /* window bits: */ 15);
+        if (status != Z_OK) throw std::runtime_error("inflateInit2 failed");
+    }
+
+    InflateStream::~InflateStream() {
+        inflateEnd(stream.get());
+    }
+
+    bool InflateStream::feed(const uint8_t* data, std::size_t size, std::vector<uint8_t>& output) {
+        static constexpr uint8_t syncFlushSuffix[] = { 0x00, 0x00, 0xFF, 0xFF };
+
+        // Fast path: whole message in one frame, no need to copy it.
+        if (pendingFrames.empty() && size >= 4 && std::memcmp(data + size - 4, syncFlushSuffix, 4) == 0) {
+            inflateBuffer(data, size, output);
+            return true;
+        }
+
+        pendingFrames.insert(pendingFrames.end(), data, data + size);
+        if (pendingFrames.size() < 4 ||
+            std::memcmp(pendingFrames.data() + pendingFrames.size() - 4, syncFlushSuffix, 4) != 0) {
+
+            return false;
+        }
+
+        inflateBuffer(pendingFrames.data(), pendingFrames.size(), output);
+        pendingFrames.clear(); // keeps capacity, so next large message don't reallocate.
+        return true;
+    }
+
+    void InflateStream::reset() {
+        pendingFrames.clear();
+        inflateReset(stream.get());
+    }
+
+    void InflateStream::inflateBuffer(const uint8_t* data, std::size_t size, std::vector<uint8_t>& output) {
+        uint8_t out[ZlibBufferSize];
+
+        output.clear();
+        stream->next_in  = const_cast<uint8_t*>(data);
+        stream->avail_in = static_cast<uInt>(size);
+        do {
+            stream->avail_out = ZlibBufferSize;
+            stream->next_out  = &out[0];
+
+            int status = inflate(stream.get(), Z_SYNC_FLUSH);
+            if (status != Z_OK && status != Z_BUF_ERROR) {
+                throw std::runtime_error(std::string("zlib-stream inflate failed: ") +
+                                         (stream->msg ? stream->msg : "unknown error"));
+            }
+
+            output.insert(output.end(), out, out + (ZlibBufferSize - stream->avail_out));
+        } while (stream->avail_in != 0 || stream->avail_out == 0);
+    }
 }
 }
 #endif
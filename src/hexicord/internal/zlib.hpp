@@ -26,11 +26,57 @@
 #ifdef HEXICORD_ZLIB
 
 #include <cstdint>
+#include <cstddef>
+#include <memory>
 #include <vector>
 
+struct z_stream_s;
+
 namespace Hexicord {
     namespace Zlib {
         std::vector<uint8_t> decompress(const std::vector<uint8_t>& input);
+
+        /**
+         *  \internal
+         *
+         *  Persistent inflate context for zlib-stream transport compression.
+         *
+         *  Gateway compresses whole connection as a single zlib stream and
+         *  flushes it (Z_SYNC_FLUSH) at end of each message, so one context
+         *  should live as long as connection does.
+         */
+        class InflateStream {
+        public:
+            InflateStream();
+            ~InflateStream();
+
+            InflateStream(const InflateStream&) = delete;
+            InflateStream& operator=(const InflateStream&) = delete;
+
+            /**
+             *  \internal
+             *
+             *  Feed single WebSocket frame. If buffered data ends with
+             *  sync-flush suffix (00 00 ff ff) - decompress it to output
+             *  and return true, otherwise keep frame buffered and return false.
+             *
+             *  \throws std::runtime_error if stream is corrupted.
+             */
+            bool feed(const uint8_t* data, std::size_t size, std::vector<uint8_t>& output);
+
+            /**
+             *  \internal
+             *
+             *  Drop buffered frames and inflate state. Should be called
+             *  before reading first message of new connection.
+             */
+            void reset();
+        private:
+            void inflateBuffer(const uint8_t* data, std::size_t size, std::vector<uint8_t>& output);
+
+            std::unique_ptr<z_stream_s> stream;
+            std::vector<uint8_t> pendingFrames;
+        };
     }
 }
 #endif // HEXICORD_ZLIB
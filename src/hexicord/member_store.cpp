@@ -0,0 +1,466 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/member_store.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace Hexicord {
+
+namespace {
+    inline size_t hashId(uint64_t id) {
+        return size_t(hashSnowflake(id));
+    }
+
+    inline size_t heapBytes(const std::string& value) {
+        // Short strings are stored inline.
+        return value.capacity() > sizeof(std::string) ? value.capacity() : 0;
+    }
+
+    inline size_t heapBytes(const std::vector<Snowflake>& value) {
+        return value.capacity() * sizeof(Snowflake);
+    }
+
+    inline int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+
+    // Avatar hash is 32 lowercase hex digits, prefixed with "a_" if animated.
+    bool packAvatar(const std::string& hash, std::array<uint8_t, 16>& bytes, bool& animated) {
+        animated = hash.size() == 34 && hash[0] == 'a' && hash[1] == '_';
+        size_t begin = animated ? 2 : 0;
+        if (hash.size() - begin != 32) return false;
+
+        for (size_t i = 0; i < 16; ++i) {
+            int high = hexDigit(hash[begin + i * 2]);
+            int low  = hexDigit(hash[begin + i * 2 + 1]);
+            if (high < 0 || low < 0) return false;
+            bytes[i] = uint8_t(high << 4 | low);
+        }
+        return true;
+    }
+
+    std::string unpackAvatar(const std::array<uint8_t, 16>& bytes, bool animated) {
+        static const char digits[] = "0123456789abcdef";
+
+        std::string result(animated ? "a_" : "");
+        result.reserve(result.size() + 32);
+        for (uint8_t byte : bytes) {
+            result += digits[byte >> 4];
+            result += digits[byte & 0xF];
+        }
+        return result;
+    }
+} // anonymous namespace
+
+constexpr uint32_t MemberStore::emptySlot;
+
+template<typename T, typename Hash>
+uint32_t MemberStore::InternPool<T, Hash>::acquire(const T& value) {
+    if (value.empty()) return 0;
+
+    auto it = index.find(value);
+    if (it != index.end()) {
+        ++it->second.refs;
+        return it->second.id;
+    }
+
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = uint32_t(byId.size() + 1);
+        byId.push_back(nullptr);
+    }
+
+    auto inserted = index.emplace(value, Entry{ id, 1 }).first;
+    byId[id - 1] = &*inserted;
+    return id;
+}
+
+template<typename T, typename Hash>
+void MemberStore::InternPool<T, Hash>::addRef(uint32_t id) {
+    if (id == 0) return;
+    ++byId[id - 1]->second.refs;
+}
+
+template<typename T, typename Hash>
+void MemberStore::InternPool<T, Hash>::release(uint32_t id) {
+    if (id == 0) return;
+
+    auto* node = byId[id - 1];
+    if (--node->second.refs != 0) return;
+
+    index.erase(node->first);
+    byId[id - 1] = nullptr;
+    freeIds.push_back(id);
+}
+
+template<typename T, typename Hash>
+const T& MemberStore::InternPool<T, Hash>::get(uint32_t id) const {
+    static const T emptyValue;
+    return id == 0 ? emptyValue : byId[id - 1]->first;
+}
+
+template<typename T, typename Hash>
+void MemberStore::InternPool<T, Hash>::clear() {
+    index.clear();
+    byId.clear();
+    freeIds.clear();
+}
+
+template<typename T, typename Hash>
+size_t MemberStore::InternPool<T, Hash>::memoryUsage() const {
+    // Rough estimate: node with cached hash, bucket and lookup table entry.
+    constexpr size_t nodeOverhead = sizeof(void*) * 3 + sizeof(size_t);
+
+    size_t result = index.size() * (nodeOverhead + sizeof(typename Index::value_type)) +
+                    freeIds.capacity() * sizeof(uint32_t);
+    for (const auto& pair : index) {
+        result += heapBytes(pair.first);
+    }
+    return result;
+}
+
+size_t MemberStore::RoleSetHash::operator()(const std::vector<Snowflake>& roles) const {
+    size_t result = roles.size();
+    for (Snowflake role : roles) {
+        result = (result ^ hashId(role)) * 0x100000001b3ULL;
+    }
+    return result;
+}
+
+void MemberStore::reserve(size_t count) {
+    userIds.reserve(count);
+    nickIds.reserve(count);
+    roleSetIds.reserve(count);
+    joinTimes.reserve(count);
+    flags.reserve(count);
+    nameOffsets.reserve(count);
+    nameLengths.reserve(count);
+    discriminators.reserve(count);
+    avatars.reserve(count);
+
+    size_t capacity = 16;
+    while (capacity < count * 2) capacity *= 2;
+    if (capacity > index.size()) rehash(capacity);
+}
+
+void MemberStore::set(const CachedMember& member) {
+    std::vector<Snowflake> roles = member.roles;
+    std::sort(roles.begin(), roles.end());
+    roles.erase(std::unique(roles.begin(), roles.end()), roles.end());
+
+    // Acquire before release, so unchanged values are not dropped from pools.
+    uint32_t nickId    = nicks.acquire(member.nick);
+    uint32_t roleSetId = roleSets.acquire(roles);
+    uint8_t  memberFlags = (member.deaf ? Deaf : 0) | (member.mute ? Mute : 0);
+
+    if ((userIds.size() + 1) * 2 > index.size()) {
+        rehash(std::max<size_t>(16, index.size() * 2));
+    }
+
+    size_t slot = findSlot(member.userId);
+    if (index[slot] != emptySlot) {
+        uint32_t row = index[slot] - 1;
+        nicks.release(nickIds[row]);
+        roleSets.release(roleSetIds[row]);
+
+        nickIds[row]    = nickId;
+        roleSetIds[row] = roleSetId;
+        joinTimes[row]  = member.joinedAt;
+        flags[row]      = uint8_t((flags[row] & UserFlags) | memberFlags);
+        return;
+    }
+
+    index[slot] = uint32_t(userIds.size() + 1);
+    userIds.push_back(member.userId);
+    nickIds.push_back(nickId);
+    roleSetIds.push_back(roleSetId);
+    joinTimes.push_back(member.joinedAt);
+    flags.push_back(memberFlags);
+    nameOffsets.push_back(0);
+    nameLengths.push_back(0);
+    discriminators.push_back(0);
+    avatars.push_back({});
+}
+
+boost::optional<CachedMember> MemberStore::get(Snowflake userId) const {
+    if (index.empty()) return boost::none;
+
+    size_t slot = findSlot(userId);
+    if (index[slot] == emptySlot) return boost::none;
+
+    uint32_t row = index[slot] - 1;
+
+    CachedMember member;
+    member.userId   = userId;
+    member.nick     = nicks.get(nickIds[row]);
+    member.roles    = roleSets.get(roleSetIds[row]);
+    member.joinedAt = joinTimes[row];
+    member.deaf     = flags[row] & Deaf;
+    member.mute     = flags[row] & Mute;
+    return member;
+}
+
+bool MemberStore::contains(Snowflake userId) const {
+    return !index.empty() && index[findSlot(userId)] != emptySlot;
+}
+
+bool MemberStore::setUser(const CachedUser& user) {
+    int64_t row = findRow(user.id);
+    if (row < 0) return false;
+
+    setName(uint32_t(row), user.username);
+    discriminators[row] = user.discriminator;
+
+    uint8_t userFlags = user.bot ? Bot : 0;
+    if (flags[row] & IrregularAvatar) irregularAvatars.erase(user.id);
+    if (!user.avatar.empty()) {
+        bool animated;
+        if (packAvatar(user.avatar, avatars[row], animated)) {
+            userFlags |= HasAvatar | (animated ? AnimatedAvatar : 0);
+        } else {
+            userFlags |= IrregularAvatar;
+            irregularAvatars[user.id] = user.avatar;
+        }
+    }
+    flags[row] = uint8_t((flags[row] & ~UserFlags) | userFlags);
+
+    compactNames();
+    return true;
+}
+
+boost::optional<CachedUser> MemberStore::getUser(Snowflake userId) const {
+    int64_t row = findRow(userId);
+    if (row < 0) return boost::none;
+
+    CachedUser user;
+    user.id            = userId;
+    user.username      = names.substr(nameOffsets[row], nameLengths[row]);
+    user.discriminator = discriminators[row];
+    user.bot           = flags[row] & Bot;
+    if (flags[row] & HasAvatar) {
+        user.avatar = unpackAvatar(avatars[row], flags[row] & AnimatedAvatar);
+    } else if (flags[row] & IrregularAvatar) {
+        user.avatar = irregularAvatars.at(userId);
+    }
+    return user;
+}
+
+bool MemberStore::erase(Snowflake userId) {
+    if (index.empty()) return false;
+
+    size_t slot = findSlot(userId);
+    if (index[slot] == emptySlot) return false;
+
+    uint32_t row = index[slot] - 1;
+    eraseSlot(slot);
+
+    nicks.release(nickIds[row]);
+    roleSets.release(roleSetIds[row]);
+    if (flags[row] & IrregularAvatar) irregularAvatars.erase(userId);
+    unusedNameBytes += nameLengths[row];
+
+    // Move last row into the hole.
+    uint32_t last = uint32_t(userIds.size() - 1);
+    if (row != last) {
+        userIds[row]        = userIds[last];
+        nickIds[row]        = nickIds[last];
+        roleSetIds[row]     = roleSetIds[last];
+        joinTimes[row]      = joinTimes[last];
+        flags[row]          = flags[last];
+        nameOffsets[row]    = nameOffsets[last];
+        nameLengths[row]    = nameLengths[last];
+        discriminators[row] = discriminators[last];
+        avatars[row]        = avatars[last];
+
+        index[findSlot(userIds[row])] = row + 1;
+    }
+
+    userIds.pop_back();
+    nickIds.pop_back();
+    roleSetIds.pop_back();
+    joinTimes.pop_back();
+    flags.pop_back();
+    nameOffsets.pop_back();
+    nameLengths.pop_back();
+    discriminators.pop_back();
+    avatars.pop_back();
+
+    compactNames();
+    return true;
+}
+
+void MemberStore::removeRole(Snowflake roleId) {
+    // Each role set is rewritten once, rows are only remapped.
+    std::unordered_map<uint32_t, uint32_t> remapped;
+
+    for (uint32_t& roleSetId : roleSetIds) {
+        auto it = remapped.find(roleSetId);
+        if (it == remapped.end()) {
+            const std::vector<Snowflake>& roles = roleSets.get(roleSetId);
+            if (!std::binary_search(roles.begin(), roles.end(), roleId)) {
+                remapped.emplace(roleSetId, roleSetId);
+                continue;
+            }
+
+            std::vector<Snowflake> newRoles;
+            newRoles.reserve(roles.size() - 1);
+            std::remove_copy(roles.begin(), roles.end(), std::back_inserter(newRoles), roleId);
+
+            uint32_t newId = roleSets.acquire(newRoles);
+            roleSets.release(roleSetId);
+            remapped.emplace(roleSetId, newId);
+            roleSetId = newId;
+        } else if (it->second != roleSetId) {
+            roleSets.addRef(it->second);
+            roleSets.release(roleSetId);
+            roleSetId = it->second;
+        }
+    }
+}
+
+void MemberStore::clear() {
+    userIds.clear();
+    nickIds.clear();
+    roleSetIds.clear();
+    joinTimes.clear();
+    flags.clear();
+    nameOffsets.clear();
+    nameLengths.clear();
+    discriminators.clear();
+    avatars.clear();
+    index.clear();
+    names.clear();
+    unusedNameBytes = 0;
+    irregularAvatars.clear();
+    nicks.clear();
+    roleSets.clear();
+}
+
+size_t MemberStore::memoryUsage() const {
+    size_t result = userIds.capacity()    * sizeof(uint64_t) +
+                    nickIds.capacity()    * sizeof(uint32_t) +
+                    roleSetIds.capacity() * sizeof(uint32_t) +
+                    joinTimes.capacity()  * sizeof(uint32_t) +
+                    flags.capacity()      * sizeof(uint8_t)  +
+                    index.capacity()      * sizeof(uint32_t) +
+                    nameOffsets.capacity()    * sizeof(uint32_t) +
+                    nameLengths.capacity()    * sizeof(uint8_t)  +
+                    discriminators.capacity() * sizeof(uint16_t) +
+                    avatars.capacity()        * sizeof(std::array<uint8_t, 16>) +
+                    heapBytes(names);
+
+    // Same estimate of node overhead as in InternPool.
+    constexpr size_t nodeOverhead = sizeof(void*) * 3 + sizeof(size_t);
+    for (const auto& pair : irregularAvatars) {
+        result += nodeOverhead + sizeof(pair) + heapBytes(pair.second);
+    }
+
+    return result + nicks.memoryUsage() + roleSets.memoryUsage();
+}
+
+size_t MemberStore::findSlot(uint64_t userId) const {
+    assert(!index.empty());
+
+    size_t mask = index.size() - 1;
+    size_t slot = hashId(userId) & mask;
+    while (index[slot] != emptySlot && userIds[index[slot] - 1] != userId) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+int64_t MemberStore::findRow(uint64_t userId) const {
+    if (index.empty()) return -1;
+
+    size_t slot = findSlot(userId);
+    return index[slot] == emptySlot ? -1 : int64_t(index[slot]) - 1;
+}
+
+void MemberStore::setName(uint32_t row, const std::string& name) {
+    size_t length = std::min<size_t>(name.size(), UINT8_MAX);
+
+    if (length <= nameLengths[row]) {
+        // Fits into old place.
+        names.replace(nameOffsets[row], length, name, 0, length);
+        unusedNameBytes += nameLengths[row] - length;
+    } else {
+        unusedNameBytes += nameLengths[row];
+        nameOffsets[row] = uint32_t(names.size());
+        names.append(name, 0, length);
+    }
+    nameLengths[row] = uint8_t(length);
+}
+
+void MemberStore::compactNames() {
+    if (unusedNameBytes * 2 <= names.size()) return;
+
+    std::string compacted;
+    compacted.reserve(names.size() - unusedNameBytes);
+    for (size_t row = 0; row < userIds.size(); ++row) {
+        uint32_t offset = uint32_t(compacted.size());
+        compacted.append(names, nameOffsets[row], nameLengths[row]);
+        nameOffsets[row] = offset;
+    }
+    names.swap(compacted);
+    unusedNameBytes = 0;
+}
+
+void MemberStore::rehash(size_t newCapacity) {
+    index.assign(newCapacity, emptySlot);
+
+    size_t mask = newCapacity - 1;
+    for (size_t row = 0; row < userIds.size(); ++row) {
+        size_t slot = hashId(userIds[row]) & mask;
+        while (index[slot] != emptySlot) slot = (slot + 1) & mask;
+        index[slot] = uint32_t(row + 1);
+    }
+}
+
+void MemberStore::eraseSlot(size_t slot) {
+    // Backward shift deletion: move following entries of the probe
+    // sequence into the hole unless that would put them before their home slot.
+    size_t mask = index.size() - 1;
+    size_t hole = slot;
+    size_t next = slot;
+    for (;;) {
+        next = (next + 1) & mask;
+        if (index[next] == emptySlot) break;
+
+        size_t home = hashId(userIds[index[next] - 1]) & mask;
+        bool stays = hole <= next ? (hole < home && home <= next)
+                                  : (hole < home || home <= next);
+        if (stays) continue;
+
+        index[hole] = index[next];
+        hole = next;
+    }
+    index[hole] = emptySlot;
+}
+
+} // namespace Hexicord
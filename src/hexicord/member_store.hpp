@@ -0,0 +1,199 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_MEMBER_STORE_HPP
+#define HEXICORD_MEMBER_STORE_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/optional.hpp>
+#include <hexicord/types/snowflake.hpp>
+
+/**
+ *  \file member_store.hpp
+ *
+ *  Compact storage for members of a single guild.
+ */
+
+namespace Hexicord {
+    struct CachedUser {
+        Snowflake id;
+        std::string username;
+        std::string avatar; ///< Empty if user have default avatar.
+        uint16_t discriminator = 0;
+        bool bot = false;
+    };
+
+    struct CachedMember {
+        Snowflake guildId;
+        Snowflake userId;
+        std::string nick;             ///< Empty if not set.
+        std::vector<Snowflake> roles; ///< Sorted by ID.
+        uint32_t joinedAt = 0;        ///< Unix timestamp (seconds).
+        bool deaf = false, mute = false;
+    };
+
+    /**
+     * Members of one guild stored column-wise.
+     *
+     * Every member takes a fixed row in parallel arrays (user ID, nickname ID,
+     * role set ID, join time, flags and user fields) and is located through
+     * open-addressing index on user ID. Nicknames and role sets are interned
+     * and reference counted, since most members of large guild share the same
+     * few role combinations and have no nickname. Usernames are packed into
+     * one character buffer and avatar hashes are kept as 16 raw bytes.
+     * This keeps usage around 70 bytes per member, including user record,
+     * instead of kilobytes for JSON or node-based maps.
+     *
+     * Not thread-safe, \ref Cache guards it with its own mutex.
+     */
+    class MemberStore {
+    public:
+        size_t size() const { return userIds.size(); }
+        void reserve(size_t count);
+
+        /**
+         * Insert new member or replace existing one with same user ID.
+         * guildId field is ignored.
+         */
+        void set(const CachedMember& member);
+
+        /**
+         * Get member by user ID. guildId field of returned record is not set.
+         */
+        boost::optional<CachedMember> get(Snowflake userId) const;
+
+        bool contains(Snowflake userId) const;
+
+        /**
+         * Replace user record of member with ID user.id.
+         *
+         * \returns false if there is no such member.
+         */
+        bool setUser(const CachedUser& user);
+
+        /**
+         * User record of member, empty (except ID) until set by \ref setUser.
+         */
+        boost::optional<CachedUser> getUser(Snowflake userId) const;
+
+        /**
+         * \returns false if there is no such member.
+         */
+        bool erase(Snowflake userId);
+
+        /**
+         * Remove role from all members (used when role is deleted).
+         */
+        void removeRole(Snowflake roleId);
+
+        void clear();
+
+        /**
+         * Approximate heap usage in bytes, including interned values.
+         */
+        size_t memoryUsage() const;
+    private:
+        /**
+         * Reference-counted set of unique values addressed by 32-bit ID.
+         * ID 0 is reserved for default-constructed (empty) value and is never stored.
+         */
+        template<typename T, typename Hash = std::hash<T>>
+        class InternPool {
+        public:
+            uint32_t acquire(const T& value);
+            void addRef(uint32_t id);
+            void release(uint32_t id);
+            const T& get(uint32_t id) const;
+            size_t size() const { return index.size(); }
+            size_t memoryUsage() const;
+            void clear();
+        private:
+            struct Entry {
+                uint32_t id;
+                uint32_t refs;
+            };
+            using Index = std::unordered_map<T, Entry, Hash>;
+
+            Index index;
+            // Node pointers stay valid on rehash, so values are not duplicated.
+            std::vector<typename Index::value_type*> byId;
+            std::vector<uint32_t> freeIds;
+        };
+
+        struct RoleSetHash {
+            size_t operator()(const std::vector<Snowflake>& roles) const;
+        };
+
+        enum Flags : uint8_t {
+            Deaf = 1 << 0,
+            Mute = 1 << 1,
+
+            // User fields, not changed by set().
+            Bot             = 1 << 2,
+            HasAvatar       = 1 << 3, ///< Avatar hash is in avatars.
+            AnimatedAvatar  = 1 << 4, ///< Avatar hash have "a_" prefix.
+            IrregularAvatar = 1 << 5, ///< Avatar is not hex hash and stored in irregularAvatars.
+            UserFlags = Bot | HasAvatar | AnimatedAvatar | IrregularAvatar
+        };
+
+        static constexpr uint32_t emptySlot = 0;
+
+        // Index slot for user ID: either holding it or first empty one.
+        size_t findSlot(uint64_t userId) const;
+        // Row of member or -1.
+        int64_t findRow(uint64_t userId) const;
+        void rehash(size_t newCapacity);
+        void eraseSlot(size_t slot);
+
+        void setName(uint32_t row, const std::string& name);
+        // Drop unused bytes from names once they take more than half of it.
+        void compactNames();
+
+        // Columns, row N describes single member.
+        std::vector<uint64_t> userIds;
+        std::vector<uint32_t> nickIds;
+        std::vector<uint32_t> roleSetIds;
+        std::vector<uint32_t> joinTimes;
+        std::vector<uint8_t>  flags;
+        std::vector<uint32_t> nameOffsets;
+        std::vector<uint8_t>  nameLengths; // usernames are at most 32 characters.
+        std::vector<uint16_t> discriminators;
+        std::vector<std::array<uint8_t, 16>> avatars;
+
+        // Row + 1 or emptySlot. Capacity is power of two, load factor <= 0.5.
+        std::vector<uint32_t> index;
+
+        // Usernames of all rows, referenced by nameOffsets and nameLengths.
+        std::string names;
+        size_t unusedNameBytes = 0;
+        // Avatars that don't look like hex hash (never sent by Discord in practice).
+        std::unordered_map<uint64_t, std::string> irregularAvatars;
+
+        InternPool<std::string> nicks;
+        InternPool<std::vector<Snowflake>, RoleSetHash> roleSets;
+    };
+}
+
+#endif // HEXICORD_MEMBER_STORE_HPP
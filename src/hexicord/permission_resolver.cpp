@@ -0,0 +1,270 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/permission_resolver.hpp>
+
+#include <algorithm>
+
+namespace Hexicord {
+
+namespace {
+    Snowflake idField(const GatewayJson& object, const char* key) {
+        auto it = object.find(key);
+        if (it == object.end()) return Snowflake();
+        if (it->is_string()) return Snowflake(it->get_ref<const std::string&>());
+        if (it->is_number()) return Snowflake(it->get<uint64_t>());
+        return Snowflake();
+    }
+} // anonymous namespace
+
+constexpr uint64_t PermissionResolver::allPermissions;
+
+PermissionResolver::PermissionResolver(const Cache& cache)
+    : cache(cache) {}
+
+void PermissionResolver::attach(EventDispatcher& dispatcher) {
+    auto guildChanged = [this](const GatewayJson& payload) {
+        invalidateGuild(idField(payload, "id"));
+    };
+    auto rolesChanged = [this](const GatewayJson& payload) {
+        invalidateGuild(idField(payload, "guild_id"));
+    };
+    auto channelChanged = [this](const GatewayJson& payload) {
+        invalidateChannel(idField(payload, "guild_id"), idField(payload, "id"));
+    };
+    auto guildRemoved = [this](const GatewayJson& payload) {
+        removeGuild(idField(payload, "id"));
+    };
+    auto memberChanged = [this](const GatewayJson& payload) {
+        auto user = payload.find("user");
+        if (user == payload.end() || !user->is_object()) return;
+        invalidateMember(idField(payload, "guild_id"), idField(*user, "id"));
+    };
+
+    dispatcher.addHandler(Event::GuildCreate,       guildChanged);
+    dispatcher.addHandler(Event::GuildUpdate,       guildChanged);
+    dispatcher.addHandler(Event::GuildDelete,       guildRemoved);
+    dispatcher.addHandler(Event::GuildRoleCreate,   rolesChanged);
+    dispatcher.addHandler(Event::GuildRoleUpdate,   rolesChanged);
+    dispatcher.addHandler(Event::GuildRoleDelete,   rolesChanged);
+    dispatcher.addHandler(Event::ChannelUpdate,     channelChanged);
+    dispatcher.addHandler(Event::ChannelDelete,     channelChanged);
+    dispatcher.addHandler(Event::GuildMemberUpdate, memberChanged);
+    dispatcher.addHandler(Event::GuildMemberRemove, memberChanged);
+}
+
+boost::optional<Permissions> PermissionResolver::permissions(Snowflake guildId, Snowflake userId) {
+    uint64_t computedAt;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto guildIt = guilds.find(guildId);
+        if (guildIt != guilds.end()) {
+            auto it = guildIt->second.base.find(userId);
+            if (it != guildIt->second.base.end()) return it->second;
+        }
+        computedAt = version;
+    }
+
+    auto member = cache.member(guildId, userId);
+    if (!member) return boost::none;
+
+    auto base = computeBase(guildId, userId, *member);
+    if (!base) return boost::none;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    GuildEntry* entry = entryForStore(guildId, computedAt);
+    if (entry) entry->base[userId] = *base;
+    return base;
+}
+
+boost::optional<Permissions> PermissionResolver::permissions(Snowflake guildId, Snowflake channelId, Snowflake userId) {
+    uint64_t computedAt;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto guildIt = guilds.find(guildId);
+        if (guildIt != guilds.end()) {
+            auto channelIt = guildIt->second.channels.find(channelId);
+            if (channelIt != guildIt->second.channels.end()) {
+                auto it = channelIt->second.find(userId);
+                if (it != channelIt->second.end()) return it->second;
+            }
+        }
+        computedAt = version;
+    }
+
+    // Cache is read without our lock held. If it changes meanwhile,
+    // invalidation handler bumps version and result is just not stored.
+    auto member = cache.member(guildId, userId);
+    if (!member) return boost::none;
+
+    auto channel = cache.channel(channelId);
+    if (!channel || channel->guildId != guildId) return boost::none;
+
+    auto base = computeBase(guildId, userId, *member);
+    if (!base) return boost::none;
+
+    Permissions result = base->get(Administrator) ? Permissions(allPermissions)
+                                                  : applyOverwrites(*base, *channel, *member);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    GuildEntry* entry = entryForStore(guildId, computedAt);
+    if (entry) {
+        entry->base[userId] = *base;
+        entry->channels[channelId][userId] = result;
+    }
+    return result;
+}
+
+bool PermissionResolver::has(Snowflake guildId, Snowflake channelId, Snowflake userId, Permissions required) {
+    auto result = permissions(guildId, channelId, userId);
+    return result && (*result & required) == required;
+}
+
+void PermissionResolver::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Values being computed now are stale too.
+    ++version;
+    absentInvalidatedAt = version;
+    guilds.clear();
+}
+
+boost::optional<Permissions> PermissionResolver::computeBase(Snowflake guildId, Snowflake userId,
+                                                             const CachedMember& member) const {
+    auto guild = cache.guild(guildId);
+    if (!guild || guild->unavailable) return boost::none;
+
+    if (guild->ownerId == userId) return Permissions(allPermissions);
+
+    // @everyone role have same ID as guild.
+    Permissions result(0);
+    auto everyone = cache.role(guildId);
+    if (everyone) result |= everyone->permissions;
+
+    for (Snowflake roleId : member.roles) {
+        auto role = cache.role(roleId);
+        if (role) result |= role->permissions;
+    }
+
+    if (result.get(Administrator)) return Permissions(allPermissions);
+    return result;
+}
+
+Permissions PermissionResolver::applyOverwrites(Permissions base, const CachedChannel& channel,
+                                                const CachedMember& member) {
+    const PermissionOverwrite* everyoneOverwrite = nullptr;
+    const PermissionOverwrite* memberOverwrite   = nullptr;
+    Permissions rolesAllow(0), rolesDeny(0);
+
+    for (const PermissionOverwrite& overwrite : channel.overwrites) {
+        if (overwrite.type == PermissionOverwrite::Member) {
+            if (overwrite.id == member.userId) memberOverwrite = &overwrite;
+        } else if (overwrite.id == channel.guildId) {
+            everyoneOverwrite = &overwrite;
+        } else if (std::binary_search(member.roles.begin(), member.roles.end(), overwrite.id)) {
+            rolesAllow |= overwrite.allow;
+            rolesDeny  |= overwrite.deny;
+        }
+    }
+
+    Permissions result = base;
+    if (everyoneOverwrite) {
+        result &= ~everyoneOverwrite->deny;
+        result |= everyoneOverwrite->allow;
+    }
+    result &= ~rolesDeny;
+    result |= rolesAllow;
+    if (memberOverwrite) {
+        result &= ~memberOverwrite->deny;
+        result |= memberOverwrite->allow;
+    }
+    return result;
+}
+
+PermissionResolver::GuildEntry* PermissionResolver::entryForStore(Snowflake guildId, uint64_t computedAt) {
+    auto it = guilds.find(guildId);
+    if (it != guilds.end()) {
+        return it->second.invalidatedAt <= computedAt ? &it->second : nullptr;
+    }
+
+    if (absentInvalidatedAt > computedAt) return nullptr;
+
+    GuildEntry& entry = guilds[guildId];
+    entry.invalidatedAt = absentInvalidatedAt;
+    return &entry;
+}
+
+PermissionResolver::GuildEntry* PermissionResolver::invalidate(Snowflake guildId) {
+    ++version;
+
+    auto it = guilds.find(guildId);
+    if (it == guilds.end()) {
+        // Values for this guild may be being computed right now.
+        absentInvalidatedAt = version;
+        return nullptr;
+    }
+
+    it->second.invalidatedAt = version;
+    return &it->second;
+}
+
+void PermissionResolver::invalidateGuild(Snowflake guildId) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    GuildEntry* entry = invalidate(guildId);
+    if (!entry) return;
+
+    entry->base.clear();
+    entry->channels.clear();
+}
+
+void PermissionResolver::removeGuild(Snowflake guildId) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    guilds.erase(guildId);
+    ++version;
+    absentInvalidatedAt = version;
+}
+
+void PermissionResolver::invalidateChannel(Snowflake guildId, Snowflake channelId) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    GuildEntry* entry = invalidate(guildId);
+    if (!entry) return;
+
+    entry->channels.erase(channelId);
+}
+
+void PermissionResolver::invalidateMember(Snowflake guildId, Snowflake userId) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    GuildEntry* entry = invalidate(guildId);
+    if (!entry) return;
+
+    entry->base.erase(userId);
+    for (auto& channel : entry->channels) {
+        channel.second.erase(userId);
+    }
+}
+
+} // namespace Hexicord
@@ -0,0 +1,141 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_PERMISSION_RESOLVER_HPP
+#define HEXICORD_PERMISSION_RESOLVER_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <boost/optional.hpp>
+#include <hexicord/cache.hpp>
+#include <hexicord/event_dispatcher.hpp>
+#include <hexicord/permission.hpp>
+#include <hexicord/snowflake_map.hpp>
+#include <hexicord/types/snowflake.hpp>
+
+/**
+ *  \file permission_resolver.hpp
+ *
+ *  Computation of effective member permissions from cached guild state.
+ */
+
+namespace Hexicord {
+    /**
+     * Computes effective permissions of members using roles and permission
+     * overwrites from \ref Cache and memoizes results per guild, channel and
+     * member.
+     *
+     * Usage:
+     * ```cpp
+     * Hexicord::Cache cache;
+     * Hexicord::PermissionResolver resolver(cache);
+     * cache.attach(gclient.eventDispatcher);
+     * resolver.attach(gclient.eventDispatcher); // after cache!
+     * // ...
+     * if (resolver.has(guildId, channelId, userId, Hexicord::ManageMessages)) { ... }
+     * ```
+     *
+     * Calculation follows https://discordapp.com/developers/docs/topics/permissions:
+     * guild owner and Administrator get everything, otherwise @everyone role
+     * and member roles are OR-ed, then @everyone, role and member overwrites
+     * of channel are applied in this order.
+     *
+     * Memoized values are dropped when events change their inputs: role and
+     * guild updates drop whole guild, channel updates drop this channel,
+     * member updates drop this member, GuildDelete removes guild entry.
+     * All methods are thread-safe.
+     */
+    class PermissionResolver {
+    public:
+        explicit PermissionResolver(const Cache& cache);
+
+        /**
+         * Add invalidation handlers. Should be called after \ref Cache::attach
+         * on same dispatcher, so cache is already updated when they run.
+         * Resolver should outlive dispatcher.
+         */
+        void attach(EventDispatcher& dispatcher);
+
+        /**
+         * Guild-level permissions of member (without channel overwrites).
+         *
+         * \returns boost::none if guild or member is not cached.
+         */
+        boost::optional<Permissions> permissions(Snowflake guildId, Snowflake userId);
+
+        /**
+         * Effective permissions of member in guild channel.
+         *
+         * \returns boost::none if guild, channel or member is not cached.
+         */
+        boost::optional<Permissions> permissions(Snowflake guildId, Snowflake channelId, Snowflake userId);
+
+        /**
+         * Check whether member have all required permissions in channel.
+         * Returns false if something is not cached.
+         */
+        bool has(Snowflake guildId, Snowflake channelId, Snowflake userId, Permissions required);
+
+        /**
+         * Drop all memoized values.
+         */
+        void clear();
+
+        static constexpr uint64_t allPermissions = ~uint64_t(0);
+    private:
+        struct GuildEntry {
+            // Value of version at last invalidation, values computed from
+            // older state are not inserted.
+            uint64_t invalidatedAt = 0;
+            SnowflakeMap<Permissions> base;                        // by user
+            SnowflakeMap<SnowflakeMap<Permissions>> channels;      // by channel, then user
+        };
+
+        // mutex should be locked for these.
+        // Returns entry to store values computed at version, creating it if
+        // needed, or nullptr if guild was invalidated since.
+        GuildEntry* entryForStore(Snowflake guildId, uint64_t computedAt);
+        // Bumps version, returns nullptr if there is no entry.
+        GuildEntry* invalidate(Snowflake guildId);
+
+        boost::optional<Permissions> computeBase(Snowflake guildId, Snowflake userId,
+                                                 const CachedMember& member) const;
+        static Permissions applyOverwrites(Permissions base, const CachedChannel& channel,
+                                           const CachedMember& member);
+
+        void invalidateGuild(Snowflake guildId);
+        void removeGuild(Snowflake guildId);
+        void invalidateChannel(Snowflake guildId, Snowflake channelId);
+        void invalidateMember(Snowflake guildId, Snowflake userId);
+
+        const Cache& cache;
+
+        std::mutex mutex;
+        SnowflakeMap<GuildEntry> guilds;
+        // Incremented on every invalidation.
+        uint64_t version = 0;
+        // Value of version at last invalidation of guild without entry,
+        // inherited by newly created entries.
+        uint64_t absentInvalidatedAt = 0;
+    };
+}
+
+#endif // HEXICORD_PERMISSION_RESOLVER_HPP
@@ -0,0 +1,415 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/ratelimit_scheduler.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <hexicord/config.hpp>
+#include <hexicord/internal/utils.hpp>      // Utils::parseHttpDate
+
+#if defined(HEXICORD_DEBUG_LOG) && defined(HEXICORD_DEBUG_RATELIMITLOCK)
+    #include <iostream>
+    #define DEBUG_MSG(msg) do { std::cerr << "ratelimit_scheduler.cpp:" << __LINE__ << "\t" << (msg) << '\n'; } while (false)
+#else
+    #define DEBUG_MSG(msg)
+#endif
+
+#ifndef HEXICORD_RATELIMIT_CACHE_SIZE
+    #define HEXICORD_RATELIMIT_CACHE_SIZE 512
+#endif
+
+namespace Hexicord {
+
+namespace {
+    // Buckets are shared between routes with same hash, but limits are
+    // still separate for each major parameter (first ID in route).
+    std::string majorParameter(const std::string& route) {
+        size_t begin = 0;
+        while (begin < route.size()) {
+            size_t end = route.find('/', begin + 1);
+            if (end == std::string::npos) end = route.size();
+
+            std::string part = route.substr(begin + 1, end - begin - 1);
+            if (!part.empty() && std::all_of(part.begin(), part.end(), ::isdigit)) {
+                return ":" + part;
+            }
+            begin = end;
+        }
+        return "";
+    }
+
+    // Header values come from network, so these don't throw and
+    // return false for malformed or out of range values.
+
+    bool parseCount(const std::string& value, int& result) {
+        if (value.empty()) return false;
+
+        char* end;
+        errno = 0;
+        long parsed = std::strtol(value.c_str(), &end, 10);
+        if (*end != '\0' || errno == ERANGE || parsed < 0 || parsed > INT_MAX) return false;
+
+        result = int(parsed);
+        return true;
+    }
+
+    bool parseSeconds(const std::string& value, std::chrono::milliseconds& result) {
+        if (value.empty()) return false;
+
+        char* end;
+        double seconds = std::strtod(value.c_str(), &end);
+        // Upper bound keeps milliseconds count in range of long long.
+        if (*end != '\0' || !std::isfinite(seconds) || seconds < 0 || seconds > 1e12) return false;
+
+        result = std::chrono::milliseconds(std::llround(seconds * 1000));
+        return true;
+    }
+} // anonymous namespace
+
+constexpr size_t RatelimitScheduler::shardCount;
+
+RatelimitScheduler::RatelimitScheduler(boost::asio::io_service& ioService, bool predict)
+    : ioService(ioService)
+    , predict(predict)
+    , globalTimer(ioService) {}
+
+RatelimitScheduler::~RatelimitScheduler() {
+    boost::system::error_code ec;
+    {
+        std::lock_guard<std::mutex> lock(globalMutex);
+        globalTimer.cancel(ec);
+    }
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& pair : shard.buckets) {
+            if (pair.second.timer) pair.second.timer->cancel(ec);
+        }
+    }
+}
+
+void RatelimitScheduler::schedule(const std::string& route, std::function<void()> proceed) {
+    Shard& shard = shardFor(route);
+
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        const std::string key = bucketKey(shard, route);
+        shard.buckets[key].queue.push_back(std::move(proceed));
+        pump(shard, key, ready);
+    }
+    release(ready);
+}
+
+void RatelimitScheduler::acquire(const std::string& route) {
+    Shard& shard = shardFor(route);
+
+    for (;;) {
+        Clock::time_point now = Clock::now(), wakeAt = globalResetAt();
+        if (now >= wakeAt) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            Bucket& routeBucket = bucket(shard, route);
+            refill(routeBucket, now);
+
+            // Unlike schedule, don't wait for limits to be known, there is no way to get notified.
+            if (routeBucket.remaining != 0) {
+                if (routeBucket.remaining > 0) --routeBucket.remaining;
+                ++routeBucket.inFlight;
+                return;
+            }
+            wakeAt = routeBucket.resetAt;
+        }
+
+        DEBUG_MSG(std::string("Ratelimit hit for route ") + route + ", blocking for " +
+                  std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - now).count()) + " ms");
+
+        std::this_thread::sleep_until(wakeAt);
+    }
+}
+
+void RatelimitScheduler::complete(const std::string& route, const REST::HeadersMap& headers,
+                                  std::chrono::milliseconds retryAfter, bool global) {
+    Shard& shard = shardFor(route);
+    Clock::time_point now = Clock::now();
+
+    if (retryAfter.count() != 0 && global) {
+        DEBUG_MSG(std::string("Global ratelimit hit, pausing for ") + std::to_string(retryAfter.count()) + " ms");
+        pauseGlobally(now + retryAfter);
+    }
+
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        Bucket& routeBucket = bucket(shard, route);
+        if (routeBucket.inFlight != 0) --routeBucket.inFlight;
+
+        updateFromHeaders(shard, route, headers, now);
+
+        if (retryAfter.count() != 0 && !global) {
+            DEBUG_MSG(std::string("Ratelimit hit for route ") + route + ", pausing for " +
+                      std::to_string(retryAfter.count()) + " ms");
+            Bucket& limitedBucket = bucket(shard, route);
+            limitedBucket.remaining = 0;
+            limitedBucket.resetAt   = std::max(limitedBucket.resetAt, now + retryAfter);
+        }
+
+        pump(shard, bucketKey(shard, route), ready);
+        pruneIdleBuckets(shard, now);
+    }
+    release(ready);
+}
+
+int RatelimitScheduler::remaining(const std::string& route) const {
+    const Shard& shard = shardFor(route);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.buckets.find(bucketKey(shard, route));
+    return it != shard.buckets.end() ? it->second.remaining : -1;
+}
+
+size_t RatelimitScheduler::queued(const std::string& route) const {
+    const Shard& shard = shardFor(route);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.buckets.find(bucketKey(shard, route));
+    return it != shard.buckets.end() ? it->second.queue.size() : 0;
+}
+
+RatelimitScheduler::Shard& RatelimitScheduler::shardFor(const std::string& route) {
+    return shards[std::hash<std::string>()(majorParameter(route)) % shardCount];
+}
+
+const RatelimitScheduler::Shard& RatelimitScheduler::shardFor(const std::string& route) const {
+    return shards[std::hash<std::string>()(majorParameter(route)) % shardCount];
+}
+
+const std::string& RatelimitScheduler::bucketKey(const Shard& shard, const std::string& route) {
+    auto it = shard.routeBuckets.find(route);
+    return it != shard.routeBuckets.end() ? it->second : route;
+}
+
+RatelimitScheduler::Bucket& RatelimitScheduler::bucket(Shard& shard, const std::string& route) {
+    return shard.buckets[bucketKey(shard, route)];
+}
+
+void RatelimitScheduler::refill(Bucket& bucket, Clock::time_point now) {
+    if (bucket.remaining >= 0 && now >= bucket.resetAt) {
+        bucket.remaining = bucket.limit;
+    }
+}
+
+void RatelimitScheduler::updateFromHeaders(Shard& shard, const std::string& route, const REST::HeadersMap& headers,
+                                           Clock::time_point now) {
+    if (!predict) return;
+
+    updateClockSkew(headers);
+
+    auto bucketIt = headers.find("X-RateLimit-Bucket");
+    if (bucketIt != headers.end()) {
+        const std::string oldKey = bucketKey(shard, route);
+        const std::string newKey = bucketIt->second + majorParameter(route);
+
+        if (oldKey != newKey) {
+            DEBUG_MSG(std::string("Route ") + route + " is in bucket " + newKey);
+
+            // Merge queue and in-flight requests into bucket shared with other routes.
+            Bucket& from = shard.buckets[oldKey];
+            Bucket& to   = shard.buckets[newKey];
+            to.inFlight += from.inFlight;
+            from.inFlight = 0;
+            std::move(from.queue.begin(), from.queue.end(), std::back_inserter(to.queue));
+            from.queue.clear();
+
+            shard.routeBuckets[route] = newKey;
+            if (!from.timerArmed) shard.buckets.erase(oldKey);
+        }
+    }
+
+    auto remainingIt  = headers.find("X-RateLimit-Remaining");
+    auto limitIt      = headers.find("X-RateLimit-Limit");
+    auto resetAfterIt = headers.find("X-RateLimit-Reset-After");
+    auto resetIt      = headers.find("X-RateLimit-Reset");
+
+    int remaining;
+    if (remainingIt == headers.end() || !parseCount(remainingIt->second, remaining)) return;
+
+    Bucket& routeBucket = bucket(shard, route);
+
+    // Other requests in flight are possibly not counted by server yet.
+    routeBucket.remaining = std::max(0, remaining - int(routeBucket.inFlight));
+    int limit;
+    if (limitIt != headers.end() && parseCount(limitIt->second, limit)) routeBucket.limit = limit;
+
+    std::chrono::milliseconds resetAfter, reset;
+    if (resetAfterIt != headers.end() && parseSeconds(resetAfterIt->second, resetAfter)) {
+        routeBucket.resetAt = now + resetAfter;
+    } else if (resetIt != headers.end() && parseSeconds(resetIt->second, reset)) {
+        // Absolute time is in server's clock.
+        auto serverNow = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()) + std::chrono::milliseconds(clockSkew.load());
+        routeBucket.resetAt = now + std::max(std::chrono::milliseconds(0), reset - serverNow);
+    } else {
+        routeBucket.resetAt = now;
+    }
+
+    DEBUG_MSG(std::string("Route ") + route +
+              ": remaining=" + std::to_string(routeBucket.remaining) +
+              ", limit=" + std::to_string(routeBucket.limit) +
+              ", reset in " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(routeBucket.resetAt - now).count()) + " ms");
+}
+
+void RatelimitScheduler::pump(Shard& shard, const std::string& key, std::vector<std::function<void()>>& ready) {
+    Bucket& bucket = shard.buckets[key];
+    Clock::time_point now = Clock::now();
+
+    while (!bucket.queue.empty()) {
+        if (now < globalResetAt()) {
+            armGlobalTimer();
+            return;
+        }
+
+        refill(bucket, now);
+        if (bucket.remaining == 0) {
+            armBucketTimer(shard, key, bucket);
+            return;
+        }
+
+        // Limits are not known yet, wait for first response.
+        if (bucket.remaining < 0 && predict && bucket.inFlight != 0) return;
+
+        if (bucket.remaining > 0) --bucket.remaining;
+        ++bucket.inFlight;
+        ready.push_back(std::move(bucket.queue.front()));
+        bucket.queue.pop_front();
+    }
+}
+
+void RatelimitScheduler::armBucketTimer(Shard& shard, const std::string& key, Bucket& bucket) {
+    if (bucket.timerArmed) return;
+
+    if (!bucket.timer) bucket.timer.reset(new boost::asio::steady_timer(ioService));
+    bucket.timerArmed = true;
+    bucket.timer->expires_at(bucket.resetAt);
+    bucket.timer->async_wait([this, &shard, key](boost::system::error_code ec) {
+        if (ec == boost::asio::error::operation_aborted) return;
+
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            auto it = shard.buckets.find(key);
+            if (it == shard.buckets.end()) return;
+            it->second.timerArmed = false;
+            pump(shard, key, ready);
+        }
+        release(ready);
+    });
+}
+
+void RatelimitScheduler::pruneIdleBuckets(Shard& shard, Clock::time_point now) {
+    if (shard.buckets.size() <= HEXICORD_RATELIMIT_CACHE_SIZE / shardCount + 1) return;
+
+    DEBUG_MSG("Ratelimit cache hit HEXICORD_RATELIMIT_CACHE_SIZE, erasing idle buckets...");
+    for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+        const Bucket& bucket = it->second;
+        bool idle = bucket.queue.empty() && bucket.inFlight == 0 && !bucket.timerArmed &&
+                    (bucket.remaining < 0 || now >= bucket.resetAt);
+        it = idle ? shard.buckets.erase(it) : std::next(it);
+    }
+    for (auto it = shard.routeBuckets.begin(); it != shard.routeBuckets.end();) {
+        it = shard.buckets.count(it->second) ? std::next(it) : shard.routeBuckets.erase(it);
+    }
+}
+
+RatelimitScheduler::Clock::time_point RatelimitScheduler::globalResetAt() const {
+    return Clock::time_point(Clock::duration(globalResetTicks.load(std::memory_order_acquire)));
+}
+
+void RatelimitScheduler::pauseGlobally(Clock::time_point until) {
+    Clock::rep ticks = until.time_since_epoch().count();
+    Clock::rep current = globalResetTicks.load(std::memory_order_relaxed);
+    while (current < ticks && !globalResetTicks.compare_exchange_weak(current, ticks, std::memory_order_release)) {}
+}
+
+void RatelimitScheduler::updateClockSkew(const REST::HeadersMap& headers) {
+    auto dateIt = headers.find("Date");
+    if (dateIt == headers.end()) return;
+
+    time_t serverTime = Utils::parseHttpDate(dateIt->second);
+    if (serverTime == 0) return;
+
+    auto localTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+    long long sample = (std::chrono::seconds(serverTime) - localTime).count();
+
+    // Date is truncated to seconds and sent before we receive it, so every
+    // sample underestimates skew by up to a second plus latency. Largest
+    // sample is the closest one. Start over if local clock was adjusted.
+    // Concurrent updates may lose a sample, which is harmless.
+    long long current = clockSkew.load();
+    if (clockSkewKnown.load() && sample <= current && sample >= current - 2000) return;
+
+    DEBUG_MSG(std::string("Server clock skew: ") + std::to_string(sample) + " ms");
+    clockSkew.store(sample);
+    clockSkewKnown.store(true);
+}
+
+void RatelimitScheduler::armGlobalTimer() {
+    std::lock_guard<std::mutex> lock(globalMutex);
+    if (globalTimerArmed) return;
+
+    globalTimerArmed = true;
+    globalTimer.expires_at(globalResetAt());
+    globalTimer.async_wait([this](boost::system::error_code ec) {
+        if (ec == boost::asio::error::operation_aborted) return;
+
+        {
+            std::lock_guard<std::mutex> lock(globalMutex);
+            globalTimerArmed = false;
+        }
+
+        std::vector<std::function<void()>> ready;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            for (auto& pair : shard.buckets) {
+                if (!pair.second.queue.empty()) pump(shard, pair.first, ready);
+            }
+        }
+        release(ready);
+    });
+}
+
+void RatelimitScheduler::release(std::vector<std::function<void()>>& ready) {
+    // Posted, so requests are never started from inside of caller.
+    for (auto& proceed : ready) {
+        ioService.post(std::move(proceed));
+    }
+}
+
+} // namespace Hexicord
@@ -0,0 +1,169 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_RATELIMIT_SCHEDULER_HPP
+#define HEXICORD_RATELIMIT_SCHEDULER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <hexicord/internal/rest.hpp>
+
+namespace Hexicord {
+    /**
+     * Schedules REST requests according to Discord rate limits.
+     *
+     * Each rate-limit bucket (reported by server in X-RateLimit-Bucket, until
+     * then each route is a bucket on it's own) have it's own queue. Queued
+     * requests are released while bucket have remaining requests, otherwise
+     * bucket waits for reset using asio timer, so requests to other buckets
+     * keep flowing. Global rate limit pauses all buckets.
+     *
+     * Until first response for bucket is received, only one request is sent,
+     * so limits are known before sending more. Without prediction only
+     * 429 responses pause buckets.
+     *
+     * All waits use steady clock with millisecond precision. Reset time is
+     * taken from X-RateLimit-Reset-After, so local clock doesn't matter. If
+     * only absolute X-RateLimit-Reset is present, it's converted using clock
+     * skew estimated from Date header.
+     *
+     * All methods are thread-safe. State is split into shards with separate
+     * locks, so requests to unrelated buckets don't contend, and global limit
+     * is checked without locking.
+     */
+    class RatelimitScheduler {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * \param predict Use X-RateLimit-* headers to avoid hitting limits
+         *                (HEXICORD_RATELIMIT_PREDICTION).
+         */
+        RatelimitScheduler(boost::asio::io_service& ioService, bool predict);
+        ~RatelimitScheduler();
+
+        /**
+         * Queue request to route (see \ref REST::Route::bucket), proceed
+         * is invoked from I/O service thread once it can be sent. Every released
+         * request should be followed by \ref complete.
+         */
+        void schedule(const std::string& route, std::function<void()> proceed);
+
+        /**
+         * Blocking version of \ref schedule for synchronous requests. Blocks
+         * only calling thread.
+         */
+        void acquire(const std::string& route);
+
+        /**
+         * Update bucket of route using response headers and release queued
+         * requests if possible. Pass empty headers if request failed.
+         *
+         * \param retryAfter Non-zero if response is 429, bucket (or all buckets
+         *                   if global is true) is paused for this time.
+         */
+        void complete(const std::string& route, const REST::HeadersMap& headers,
+                      std::chrono::milliseconds retryAfter = std::chrono::milliseconds(0),
+                      bool global = false);
+
+        /**
+         * Requests known to be remaining in bucket of route or -1 if not known.
+         */
+        int remaining(const std::string& route) const;
+
+        /**
+         * Number of requests queued for route's bucket.
+         */
+        size_t queued(const std::string& route) const;
+    private:
+        struct Bucket {
+            int limit     = -1;
+            int remaining = -1; // -1 if not known.
+            Clock::time_point resetAt;
+            unsigned inFlight = 0;
+
+            std::deque<std::function<void()>> queue;
+            std::unique_ptr<boost::asio::steady_timer> timer;
+            bool timerArmed = false;
+        };
+
+        static constexpr size_t shardCount = 16;
+
+        // Buckets are sharded by major parameter (first ID in route), so
+        // route and all buckets it may end up in are always in same shard.
+        struct Shard {
+            mutable std::mutex mutex;
+
+            // Route -> bucket key learned from X-RateLimit-Bucket. Route itself is used as key if not known.
+            std::unordered_map<std::string, std::string> routeBuckets;
+            std::unordered_map<std::string, Bucket> buckets;
+        };
+
+        Shard& shardFor(const std::string& route);
+        const Shard& shardFor(const std::string& route) const;
+
+        // Following methods expect shard's mutex to be locked.
+        static const std::string& bucketKey(const Shard& shard, const std::string& route);
+        static Bucket& bucket(Shard& shard, const std::string& route);
+        static void refill(Bucket& bucket, Clock::time_point now);
+        void updateFromHeaders(Shard& shard, const std::string& route, const REST::HeadersMap& headers,
+                               Clock::time_point now);
+        void pump(Shard& shard, const std::string& key, std::vector<std::function<void()>>& ready);
+        void armBucketTimer(Shard& shard, const std::string& key, Bucket& bucket);
+        void pruneIdleBuckets(Shard& shard, Clock::time_point now);
+
+        // Lock-free.
+        Clock::time_point globalResetAt() const;
+        void pauseGlobally(Clock::time_point until);
+        void updateClockSkew(const REST::HeadersMap& headers);
+
+        void armGlobalTimer();
+        void release(std::vector<std::function<void()>>& ready);
+
+        boost::asio::io_service& ioService;
+        const bool predict;
+
+        std::array<Shard, shardCount> shards;
+
+        // Server clock minus local system clock in ms, lower bound (Date have second precision).
+        std::atomic<long long> clockSkew { 0 };
+        std::atomic<bool> clockSkewKnown { false };
+
+        // Steady clock ticks since epoch, read on every request.
+        std::atomic<Clock::rep> globalResetTicks { 0 };
+
+        std::mutex globalMutex; // protects global timer.
+        boost::asio::steady_timer globalTimer;
+        bool globalTimerArmed = false;
+    };
+} // namespace Hexicord
+
+#endif // HEXICORD_RATELIMIT_SCHEDULER_HPP
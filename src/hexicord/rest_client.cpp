@@ -20,11 +20,11 @@
 // OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <hexicord/rest_client.hpp>
-#include <thread>                                     // std::this_thread::sleep_for
 #include <chrono>                                     // std::chrono::seconds, std::chrono::milliseconds
+#include <cmath>                                      // std::llround
 #include <fstream>                                    // std::ifstream
+#include <istream>                                    // std::istream
 #include <boost/date_time/posix_time/posix_time.hpp>
-#include <boost/beast/http/error.hpp>                 // boost::beast::http::error::end_of_stream
 #include <hexicord/exceptions.hpp>
 #include <hexicord/internal/utils.hpp>                // Utils::getRatelimitDomain, Utils::domainFromUrl
 
@@ -36,27 +36,128 @@
 #endif
 
 namespace Hexicord {
-    RestClient::RestClient(boost::asio::io_service& ioService, const std::string& token) 
-        : restConnection(new REST::HTTPSConnection(ioService, "discordapp.com"))
+    namespace {
+        struct RatelimitHitInfo {
+            std::chrono::milliseconds retryAfter;
+            bool global;
+        };
+
+        RatelimitHitInfo parseRatelimitHit(const nlohmann::json& body) {
+            RatelimitHitInfo info { std::chrono::seconds(1), false };
+            try {
+                // Milliseconds, possibly fractional.
+                info.retryAfter = std::chrono::milliseconds(std::llround(body.at("retry_after").get<double>()));
+                info.global     = body.value("global", false);
+            } catch (std::exception& excp) {
+                DEBUG_MSG(std::string("Malformed 429 response, retrying after 1 second: ") + excp.what());
+            }
+            return info;
+        }
+
+        // Declared constexpr, so templates are checked at compile time.
+        namespace Routes {
+            constexpr REST::RouteTemplate<0> getGateway("GET", "/gateway");
+            constexpr REST::RouteTemplate<0> getGatewayBot("GET", "/gateway/bot");
+            constexpr REST::RouteTemplate<1> getChannel("GET", "/channels/{channel}");
+            constexpr REST::RouteTemplate<2> getMessage("GET", "/channels/{channel}/messages/{message}");
+            constexpr REST::RouteTemplate<1> createMessage("POST", "/channels/{channel}/messages");
+            constexpr REST::RouteTemplate<2> editMessage("PATCH", "/channels/{channel}/messages/{message}");
+            constexpr REST::RouteTemplate<2> deleteMessage("DELETE", "/channels/{channel}/messages/{message}");
+            constexpr REST::RouteTemplate<3> addReaction("PUT", "/channels/{channel}/messages/{message}/reactions/{emoji}/@me");
+            constexpr REST::RouteTemplate<1> triggerTypingIndicator("POST", "/channels/{channel}/typing");
+            constexpr REST::RouteTemplate<1> modifyChannel("PATCH", "/channels/{channel}");
+            constexpr REST::RouteTemplate<1> deleteChannel("DELETE", "/channels/{channel}");
+            constexpr REST::RouteTemplate<1> getMessages("GET", "/channels/{channel}/messages");
+            constexpr REST::RouteTemplate<1> getPinnedMessages("GET", "/channels/{channel}/pins");
+            constexpr REST::RouteTemplate<2> pinMessage("PUT", "/channels/{channel}/pins/{message}");
+            constexpr REST::RouteTemplate<2> unpinMessage("DELETE", "/channels/{channel}/pins/{message}");
+            constexpr REST::RouteTemplate<2> editChannelPermissions("PUT", "/channels/{channel}/permissions/{overwrite}");
+            constexpr REST::RouteTemplate<2> deleteChannelPermissions("DELETE", "/channels/{channel}/permissions/{overwrite}");
+            constexpr REST::RouteTemplate<2> kickFromGroupDm("DELETE", "/channels/{channel}/recipients/{user}");
+            constexpr REST::RouteTemplate<2> addToGroupDm("PUT", "/channels/{channel}/recipients/{user}");
+            constexpr REST::RouteTemplate<1> deleteMessages("POST", "/channels/{channel}/messages/bulk-delete");
+            constexpr REST::RouteTemplate<3> deleteOwnReaction("DELETE", "/channels/{channel}/messages/{message}/reactions/{emoji}/@me");
+            constexpr REST::RouteTemplate<4> deleteUserReaction("DELETE", "/channels/{channel}/messages/{message}/reactions/{emoji}/{user}");
+            constexpr REST::RouteTemplate<3> getReactions("GET", "/channels/{channel}/messages/{message}/reactions/{emoji}");
+            constexpr REST::RouteTemplate<2> resetReactions("DELETE", "/channels/{channel}/messages/{message}/reactions");
+            constexpr REST::RouteTemplate<1> getGuild("GET", "/guilds/{guild}");
+            constexpr REST::RouteTemplate<0> createGuild("POST", "/guilds");
+            constexpr REST::RouteTemplate<1> modifyGuild("PATCH", "/guilds/{guild}");
+            constexpr REST::RouteTemplate<1> getBans("GET", "/guilds/{guild}/bans");
+            constexpr REST::RouteTemplate<2> banMember("PUT", "/guilds/{guild}/bans/{user}");
+            constexpr REST::RouteTemplate<2> unbanMember("DELETE", "/guilds/{guild}/bans/{user}");
+            constexpr REST::RouteTemplate<2> kickMember("DELETE", "/guilds/{guild}/members/{user}");
+            constexpr REST::RouteTemplate<1> getChannels("GET", "/guilds/{guild}/channels");
+            constexpr REST::RouteTemplate<1> getMembers("GET", "/guilds/{guild}/members");
+            constexpr REST::RouteTemplate<2> getMember("GET", "/guilds/{guild}/members/{user}");
+            constexpr REST::RouteTemplate<2> modifyMember("PATCH", "/guilds/{guild}/members/{user}");
+            constexpr REST::RouteTemplate<1> getGuildIntegrations("GET", "/guilds/{guild}/integrations");
+            constexpr REST::RouteTemplate<1> attachIntegration("POST", "/guilds/{guild}/integrations");
+            constexpr REST::RouteTemplate<2> detachIntegration("DELETE", "/guilds/{guild}/integrations/{integration}");
+            constexpr REST::RouteTemplate<2> syncIntegration("POST", "/guilds/{guild}/integrations/{integration}/sync");
+            constexpr REST::RouteTemplate<1> getGuildEmbed("GET", "/guilds/{guild}/embed");
+            constexpr REST::RouteTemplate<1> modifyGuildEmbed("PATCH", "/guilds/{guild}/embed");
+            constexpr REST::RouteTemplate<1> createChannel("POST", "/guilds/{guild}/channels");
+            constexpr REST::RouteTemplate<1> reorderChannels("PATCH", "/guilds/{guild}/channels");
+            constexpr REST::RouteTemplate<1> reorderRoles("PATCH", "/guilds/{guild}/roles");
+            constexpr REST::RouteTemplate<1> getRoles("GET", "/guilds/{guild}/roles");
+            constexpr REST::RouteTemplate<1> createRole("POST", "/guilds/{guild}/roles");
+            constexpr REST::RouteTemplate<2> modifyRole("PATCH", "/guilds/{guild}/roles/{role}");
+            constexpr REST::RouteTemplate<2> deleteRole("DELETE", "/guilds/{guild}/roles/{role}");
+            constexpr REST::RouteTemplate<3> giveRole("PUT", "/guilds/{guild}/members/{user}/roles/{role}");
+            constexpr REST::RouteTemplate<3> takeRole("DELETE", "/guilds/{guild}/members/{user}/roles/{role}");
+            constexpr REST::RouteTemplate<0> getMe("GET", "/users/@me");
+            constexpr REST::RouteTemplate<1> getUser("GET", "/users/{user}");
+            constexpr REST::RouteTemplate<0> modifyMe("PATCH", "/users/@me");
+            constexpr REST::RouteTemplate<0> getUserGuilds("GET", "/users/@me/guilds");
+            constexpr REST::RouteTemplate<1> leaveGuild("DELETE", "/users/@me/guilds/{guild}");
+            constexpr REST::RouteTemplate<0> getUserDms("GET", "/users/@me/channels");
+            constexpr REST::RouteTemplate<0> createDm("POST", "/users/@me/channels");
+            constexpr REST::RouteTemplate<0> getConnections("GET", "/users/@me/connections");
+            constexpr REST::RouteTemplate<1> getInvites("GET", "/guilds/{guild}/invites");
+            constexpr REST::RouteTemplate<1> getInvite("GET", "/invites/{invite}");
+            constexpr REST::RouteTemplate<1> revokeInvite("DELETE", "/invites/{invite}");
+            constexpr REST::RouteTemplate<1> acceptInvite("POST", "/invites/{invite}");
+            constexpr REST::RouteTemplate<1> getChannelInvites("GET", "/channels/{channel}/invites");
+            constexpr REST::RouteTemplate<1> createInvite("POST", "/channels/{channel}/invites");
+            constexpr REST::RouteTemplate<1> getWebhook("GET", "/webhooks/{webhook}");
+            constexpr REST::RouteTemplate<1> getChannelWebhooks("GET", "/channels/{channel}/webhooks");
+            constexpr REST::RouteTemplate<1> getGuildWebhooks("GET", "/guilds/{guild}/webhooks");
+            constexpr REST::RouteTemplate<1> createWebhook("POST", "/channels/{channel}/webhooks");
+            constexpr REST::RouteTemplate<1> modifyWebhook("PATCH", "/webhooks/{webhook}");
+            constexpr REST::RouteTemplate<1> deleteWebhook("DELETE", "/webhooks/{webhook}");
+        } // namespace Routes
+    } // anonymous namespace
+
+    RestClient::RestClient(boost::asio::io_service& ioService, const std::string& token, size_t maxConnections) 
+        : restPool(new REST::HTTPSConnectionPool(ioService, "discordapp.com", maxConnections))
         , token(token)
-        , ioService(ioService) {
+        , ioService(ioService)
+#ifdef HEXICORD_RATELIMIT_PREDICTION
+        , ratelimitScheduler(new RatelimitScheduler(ioService, true)) {
+#else
+        , ratelimitScheduler(new RatelimitScheduler(ioService, false)) {
+#endif
 
         // It's strange but Discord API requires "DiscordBot" user-agent for any connections
         // including non-bots. Referring to https://discordapp.com/developers/docs/reference#user-agent
-        restConnection->connectionHeaders.insert({ "User-Agent", "DiscordBot (" HEXICORD_GITHUB ", " HEXICORD_VERSION ")" });
+        restPool->setConnectionHeader("User-Agent", "DiscordBot (" HEXICORD_GITHUB ", " HEXICORD_VERSION ")");
+
+        // Sub-second precision for X-RateLimit-Reset and X-RateLimit-Reset-After.
+        restPool->setConnectionHeader("X-RateLimit-Precision", "millisecond");
     }
 
     std::string RestClient::getGatewayUrl() {
-        restConnection->connectionHeaders.insert({ "Authorization", std::string("Bearer ") + token });
+        restPool->setConnectionHeader("Authorization", std::string("Bearer ") + token);
 
-        nlohmann::json response = sendRestRequest("GET", "/gateway");
+        nlohmann::json response = sendRestRequest(Routes::getGateway.format());
         return response["url"];
     }
 
     std::pair<std::string, int> RestClient::getGatewayUrlBot() {
-        restConnection->connectionHeaders.insert({ "Authorization", std::string("Bot ") + token });
+        restPool->setConnectionHeader("Authorization", std::string("Bot ") + token);
 
-        nlohmann::json response = sendRestRequest("GET", "/gateway/bot");
+        nlohmann::json response = sendRestRequest(Routes::getGatewayBot.format());
         return { response["url"].get<std::string>(), response["shards"].get<unsigned>() };
     }
 
@@ -64,74 +165,205 @@ namespace Hexicord {
                                            const nlohmann::json& payload,
                                            const std::unordered_map<std::string, std::string>& query,
                                            const std::vector<REST::MultipartEntity>& multipart) {
+        // Bucket is guessed from path, first snowflake is assumed to be major parameter.
+        return sendRestRequest(REST::Route{ method, endpoint, method + " " + Utils::getRatelimitDomain(endpoint) },
+                               payload, query, multipart);
+    }
 
-        if (!restConnection->isOpen()) restConnection->open();
-
-        REST::HTTPRequest request;
-
-        request.method  = method;
-        request.path    = restBasePath + endpoint + Utils::makeQueryString(query);
-        request.version = 11;
-
-        prepareRequestBody(request, payload, multipart);
+    nlohmann::json RestClient::sendRestRequest(const REST::Route& route,
+                                           const nlohmann::json& payload,
+                                           const std::unordered_map<std::string, std::string>& query,
+                                           const std::vector<REST::MultipartEntity>& multipart) {
 
-        request.headers.insert({ "Accept", "application/json" });
+        REST::HTTPRequest request = buildRequest(route.method, route.path, payload, query, multipart);
 
-#ifdef HEXICORD_RATELIMIT_PREDICTION 
-        // Make sure we can do request without getting ratelimited.
-        ratelimitLock.down(Utils::getRatelimitDomain(endpoint));
-#endif
+        // Blocks only calling thread until request can be done without getting ratelimited.
+        ratelimitScheduler->acquire(route.bucket);
 
+        // Pool retries if connection was closed by remote.
+        DEBUG_MSG(std::string("Sending REST request: ") + route.method + " " + request.path + " " + payload.dump());
         REST::HTTPResponse response;
+        nlohmann::json jsonResp;
+        std::exception_ptr parseError;
         try {
-            DEBUG_MSG(std::string("Sending REST request: ") + method + " " + request.path + " " + payload.dump());
-            response = restConnection->request(request);
-        } catch (boost::system::system_error& excp) {
-            if (excp.code() != boost::beast::http::error::end_of_stream &&
-                excp.code() != boost::asio::error::broken_pipe &&
-                excp.code() != boost::asio::error::connection_reset) throw;
-
-            DEBUG_MSG("HTTP Connection closed by remote. Reopenning and retrying.");
-            {
-                REST::HeadersMap prevHeaders = std::move(restConnection->connectionHeaders);
-                restConnection.reset(new REST::HTTPSConnection(ioService, "discordapp.com"));
-                restConnection->connectionHeaders = std::move(prevHeaders);
-                restConnection->open();
-            }
-            
-            return sendRestRequest(method, endpoint, payload, query, multipart);
+            // Body is parsed while it's received, without storing it.
+            response = restPool->request(request, [&jsonResp, &parseError](const REST::HTTPResponse&, std::istream& body) {
+                jsonResp = nullptr;
+                parseError = nullptr;
+                if (body.peek() == std::char_traits<char>::eof()) return;
+
+                try {
+                    jsonResp = nlohmann::json::parse(body);
+                } catch (nlohmann::json::parse_error&) {
+                    parseError = std::current_exception();
+                }
+            });
+        } catch (...) {
+            ratelimitScheduler->complete(route.bucket, {});
+            throw;
         }
 
-        if (response.body.empty()) {
-            return {};
+        if (response.statusCode == 429) {
+            RatelimitHitInfo hit = parseRatelimitHit(jsonResp);
+            ratelimitScheduler->complete(route.bucket, response.headers, hit.retryAfter, hit.global);
+#ifdef HEXICORD_RATELIMIT_HIT_AS_ERROR
+            throw RatelimitHit(route.bucket);
+#else
+            // Next acquire waits for bucket reset.
+            return sendRestRequest(route, payload, query, multipart);
+#endif
         }
+        ratelimitScheduler->complete(route.bucket, response.headers);
 
-        nlohmann::json jsonResp = nlohmann::json::parse(response.body);
-
-#ifdef HEXICORD_RATELIMIT_PREDICTION
-        updateRatelimitsIfPresent(endpoint, response.headers);
-#endif
+        if (parseError) std::rethrow_exception(parseError);
 
         if (response.statusCode / 100 != 2) {
-            if (response.statusCode == 429) {
-#ifdef HEXICORD_RATELIMIT_HIT_AS_ERROR
-                throw RatelimitHit(Utils::getRatelimitDomain(endpoint));
-#else 
-                std::this_thread::sleep_for(std::chrono::seconds(jsonResp["retry_after"].get<unsigned>()));
-                return sendRestRequest(method, endpoint, payload, query);
-#endif 
-            }
-
             DEBUG_MSG("Got non-2xx HTTP status code.");
             DEBUG_MSG(jsonResp.dump(4));
+            if (jsonResp.is_null()) {
+                throw RESTError(std::string("HTTP status ") + std::to_string(response.statusCode), -1, response.statusCode);
+            }
             throwRestError(response, jsonResp);
         }
 
         return jsonResp;
     }
 
+    void RestClient::asyncSendRestRequest(const std::string& method, const std::string& endpoint, RestHandler handler,
+                                          const nlohmann::json& payload,
+                                          const std::unordered_map<std::string, std::string>& query,
+                                          const std::vector<REST::MultipartEntity>& multipart) {
+        asyncSendRestRequest(REST::Route{ method, endpoint, method + " " + Utils::getRatelimitDomain(endpoint) },
+                             std::move(handler), payload, query, multipart);
+    }
+
+    void RestClient::asyncSendRestRequest(const REST::Route& route, RestHandler handler,
+                                          const nlohmann::json& payload,
+                                          const std::unordered_map<std::string, std::string>& query,
+                                          const std::vector<REST::MultipartEntity>& multipart) {
+        auto pending = std::make_shared<PendingRequest>();
+        pending->request = buildRequest(route.method, route.path, payload, query, multipart);
+        pending->path    = route.path;
+        pending->bucket  = route.bucket;
+        pending->handler = std::move(handler);
+
+        DEBUG_MSG(std::string("Sending async REST request: ") + route.method + " " + pending->request.path);
+        asyncSchedule(pending);
+    }
+
+    void RestClient::asyncSchedule(std::shared_ptr<PendingRequest> pending) {
+        // Waits in bucket's queue if needed, requests to other buckets are not delayed.
+        ratelimitScheduler->schedule(pending->bucket, [this, pending]() {
+            asyncPerform(pending);
+        });
+    }
+
+    void RestClient::asyncPerform(std::shared_ptr<PendingRequest> pending) {
+        // Pool retries if connection was closed by remote and limits
+        // number of simultaneous requests.
+        restPool->asyncRequest(pending->request, [this, pending](REST::HTTPResponse response,
+                                                                 boost::system::error_code ec) {
+            if (ec) {
+                ratelimitScheduler->complete(pending->bucket, {});
+                return asyncFinish(pending, std::make_exception_ptr(boost::system::system_error(ec)), {});
+            }
+            asyncHandleResponse(pending, response);
+        });
+    }
+
+    void RestClient::asyncHandleResponse(std::shared_ptr<PendingRequest> pending, const REST::HTTPResponse& response) {
+        nlohmann::json jsonResp;
+        std::exception_ptr parseError;
+        try {
+            if (!response.body.empty()) jsonResp = nlohmann::json::parse(response.body);
+        } catch (nlohmann::json::parse_error&) {
+            parseError = std::current_exception();
+        }
+
+        if (response.statusCode == 429) {
+            RatelimitHitInfo hit = parseRatelimitHit(jsonResp);
+            ratelimitScheduler->complete(pending->bucket, response.headers, hit.retryAfter, hit.global);
+#ifdef HEXICORD_RATELIMIT_HIT_AS_ERROR
+            return asyncFinish(pending, std::make_exception_ptr(RatelimitHit(pending->bucket)), {});
+#else
+            DEBUG_MSG(std::string("Ratelimit hit for async request to ") + pending->path + ", retrying later.");
+            return asyncSchedule(pending);
+#endif
+        }
+        ratelimitScheduler->complete(pending->bucket, response.headers);
+
+        if (parseError) return asyncFinish(pending, parseError, {});
+
+        try {
+            if (response.statusCode / 100 != 2) {
+                DEBUG_MSG("Got non-2xx HTTP status code.");
+                if (jsonResp.is_null()) {
+                    throw RESTError(std::string("HTTP status ") + std::to_string(response.statusCode), -1, response.statusCode);
+                }
+                throwRestError(response, jsonResp);
+            }
+        } catch (...) {
+            return asyncFinish(pending, std::current_exception(), {});
+        }
+
+        asyncFinish(pending, nullptr, std::move(jsonResp));
+    }
+
+    void RestClient::asyncFinish(std::shared_ptr<PendingRequest> pending, std::exception_ptr error, nlohmann::json response) {
+        if (pending->handler) pending->handler(error, std::move(response));
+    }
+
+    void RestClient::asyncGetChannel(Snowflake channelId, RestHandler handler) {
+        asyncSendRestRequest(Routes::getChannel.format(channelId), std::move(handler));
+    }
+
+    void RestClient::asyncGetMessage(Snowflake channelId, Snowflake messageId, RestHandler handler) {
+        asyncSendRestRequest(Routes::getMessage.format(channelId, messageId), std::move(handler));
+    }
+
+    void RestClient::asyncSendTextMessage(Snowflake channelId, const std::string& text, RestHandler handler,
+                                          const nlohmann::json& embed, bool tts) {
+        if (text.size() > 2000) throw InvalidParameter("text", "text out of range (should be 0-2000).");
+
+        asyncSendRestRequest(Routes::createMessage.format(channelId),
+                             std::move(handler),
+                             {
+                               { "content", text  },
+                               { "tts",     tts   },
+                               { "embed",   embed }
+                             });
+    }
+
+    void RestClient::asyncSendFile(Snowflake channelId, const File& file, RestHandler handler) {
+        asyncSendRestRequest(Routes::createMessage.format(channelId),
+                             std::move(handler), {}, {}, { fileToMultipartEntity(file) });
+    }
+
+    void RestClient::asyncEditMessage(Snowflake channelId, Snowflake messageId, const std::string& text,
+                                      RestHandler handler, const nlohmann::json& embed) {
+        if (text.size() > 2000) {
+            throw InvalidParameter("text", "text size out of range (should be 0-2000)");
+        }
+        asyncSendRestRequest(Routes::editMessage.format(channelId, messageId),
+                             std::move(handler), {{ "content", text }, { "embed", embed }});
+    }
+
+    void RestClient::asyncDeleteMessage(Snowflake channelId, Snowflake messageId, RestHandler handler) {
+        asyncSendRestRequest(Routes::deleteMessage.format(channelId, messageId), std::move(handler));
+    }
+
+    void RestClient::asyncAddReaction(Snowflake channelId, Snowflake messageId, Snowflake emojiId,
+                                      RestHandler handler) {
+        asyncSendRestRequest(Routes::addReaction.format(channelId, messageId, emojiId), std::move(handler));
+    }
+
+    void RestClient::asyncTriggerTypingIndicator(Snowflake channelId, RestHandler handler) {
+        asyncSendRestRequest(Routes::triggerTypingIndicator.format(channelId),
+                             std::move(handler));
+    }
+
     nlohmann::json RestClient::getChannel(Snowflake channelId) {
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId));
+        return sendRestRequest(Routes::getChannel.format(channelId));
     }
 
     nlohmann::json RestClient::modifyChannel(Snowflake channelId,
@@ -175,11 +407,11 @@ namespace Hexicord {
             throw InvalidParameter("", "No arguments passed to modifyChannel.");
         }
 
-        return sendRestRequest("POST", std::string("/channels/") + std::to_string(channelId), payload);
+        return sendRestRequest(Routes::modifyChannel.format(channelId), payload);
     }
 
     nlohmann::json RestClient::deleteChannel(Snowflake channelId) {
-        return sendRestRequest("DELETE", std::string("/channels/") + std::to_string(channelId));
+        return sendRestRequest(Routes::deleteChannel.format(channelId));
     }
 
     nlohmann::json RestClient::getMessages(Snowflake channelId, RestClient::After afterId, unsigned limit) {
@@ -187,7 +419,7 @@ namespace Hexicord {
             throw InvalidParameter("limit", "limit out of range (should be 1-100).");
         }
 
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId) + "/messages",
+        return sendRestRequest(Routes::getMessages.format(channelId),
                                {}, {{ "after", std::to_string(afterId.id) },
                                     { "limit", std::to_string(limit) }});
     }
@@ -197,7 +429,7 @@ namespace Hexicord {
             throw InvalidParameter("limit", "limit out of range (should be 1-100).");
         }
 
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId) + "/messages",
+        return sendRestRequest(Routes::getMessages.format(channelId),
                                {}, {{ "before", std::to_string(afterId.id) },
                                     { "limit", std::to_string(limit) }});
     }
@@ -207,36 +439,31 @@ namespace Hexicord {
             throw InvalidParameter("limit", "limit out of range (should be 2-100).");
         }
 
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId) + "/messages",
+        return sendRestRequest(Routes::getMessages.format(channelId),
                                {}, {{ "around", std::to_string(afterId.id) },
                                     { "limit", std::to_string(limit) }});
     }
 
     nlohmann::json RestClient::getMessage(Snowflake channelId, Snowflake messageId) {
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId) + 
-                               "/messsages/" + std::to_string(messageId));
+        return sendRestRequest(Routes::getMessage.format(channelId, messageId));
     }
 
     nlohmann::json RestClient::getPinnedMessages(Snowflake channelId) {
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId) +
-                                                  "/pins");
+        return sendRestRequest(Routes::getPinnedMessages.format(channelId));
     }
 
     void RestClient::pinMessage(Snowflake channelId, Snowflake messageId) {
-        sendRestRequest("PUT", std::string("/channels/") + std::to_string(channelId) +
-                                           "/pins/"      + std::to_string(messageId));
+        sendRestRequest(Routes::pinMessage.format(channelId, messageId));
     }
 
     void RestClient::unpinMessage(Snowflake channelId, Snowflake messageId) {
-        sendRestRequest("DELETE", std::string("/channels/") + std::to_string(channelId) +
-                                              "/pins/"      + std::to_string(messageId));
+        sendRestRequest(Routes::unpinMessage.format(channelId, messageId));
     }
 
     void RestClient::editChannelRolePermissions(Snowflake channelId, Snowflake roleId,
                                     Permissions allow, Permissions deny) {
 
-        sendRestRequest("PUT", std::string("/channels/")   + std::to_string(channelId) +
-                                           "/permissions/" + std::to_string(roleId),
+        sendRestRequest(Routes::editChannelPermissions.format(channelId, roleId),
             {
                 { "allow", int(allow) },
                 { "deny",  int(deny)  },
@@ -247,8 +474,7 @@ namespace Hexicord {
     void RestClient::editChannelUserPermissions(Snowflake channelId, Snowflake userId,
                                     Permissions allow, Permissions deny) {
 
-        sendRestRequest("PUT", std::string("/channels/")   + std::to_string(channelId) +
-                                           "/permissions/" + std::to_string(userId),
+        sendRestRequest(Routes::editChannelPermissions.format(channelId, userId),
             {
                 { "allow", int(allow) },
                 { "deny",  int(deny)  },
@@ -257,20 +483,17 @@ namespace Hexicord {
     }
 
     void RestClient::deleteChannelPermissions(Snowflake channelId, Snowflake overrideId) {
-        sendRestRequest("DELETE", std::string("/channels/")   + std::to_string(channelId) +
-                                              "/permissions/" + std::to_string(overrideId));
+        sendRestRequest(Routes::deleteChannelPermissions.format(channelId, overrideId));
     }
 
     void RestClient::kickFromGroupDm(Snowflake groupDmId, Snowflake userId) {
-        sendRestRequest("DELETE", std::string("/channels/")  + std::to_string(groupDmId) +
-                                              "/recipients/" + std::to_string(userId));
+        sendRestRequest(Routes::kickFromGroupDm.format(groupDmId, userId));
     }
 
     void RestClient::addToGroupDm(Snowflake groupDmId, Snowflake userId,
                               const std::string& accessToken, const std::string& nick) {
 
-        sendRestRequest("PUT", std::string("/channels/")  + std::to_string(groupDmId) +
-                                           "/recipients/" + std::to_string(userId),
+        sendRestRequest(Routes::addToGroupDm.format(groupDmId, userId),
                         {
                             { "access_token", accessToken },
                             { "nick",         nick        }
@@ -278,14 +501,14 @@ namespace Hexicord {
     }
 
     void RestClient::triggerTypingIndicator(Snowflake channelId) {
-        sendRestRequest("POST", std::string("/channels/") + std::to_string(channelId) + "/typing");
+        sendRestRequest(Routes::triggerTypingIndicator.format(channelId));
     }
 
     nlohmann::json RestClient::sendTextMessage(Snowflake channelId, const std::string& text,
                                                const nlohmann::json& embed, bool tts) {
         if (text.size() > 2000) throw InvalidParameter("text", "text out of range (should be 0-2000).");
 
-        return sendRestRequest("POST", std::string("/channels/") + std::to_string(channelId) + "/messages",
+        return sendRestRequest(Routes::createMessage.format(channelId),
                 {
                   { "content", text  },
                   { "tts",     tts   },
@@ -294,7 +517,7 @@ namespace Hexicord {
     }
 
     nlohmann::json RestClient::sendFile(Snowflake channelId, const File& file) {
-        return sendRestRequest("POST", std::string("/channels/") + std::to_string(channelId) + "/messages",
+        return sendRestRequest(Routes::createMessage.format(channelId),
                                {}, {}, { fileToMultipartEntity(file) });
     }
 
@@ -303,160 +526,130 @@ namespace Hexicord {
         if (text.size() > 2000) {
             throw InvalidParameter("text", "text size out of range (should be 0-1024)");
         }
-        return sendRestRequest("PATCH", std::string("/channels/") + std::to_string(channelId) +
-                               "/messages/" + std::to_string(messageId),
+        return sendRestRequest(Routes::editMessage.format(channelId, messageId),
                                {{ "content", text }, { "embed", embed }});
     }
 
     void RestClient::deleteMessage(Snowflake channelId, Snowflake messageId) {
-        sendRestRequest("DELETE", std::string("/channels/") + std::to_string(channelId) + "/messages/" +
-                        std::to_string(messageId));
+        sendRestRequest(Routes::deleteMessage.format(channelId, messageId));
     }
 
     void RestClient::deleteMessages(Snowflake channelId, const std::vector<Snowflake>& messageIds) {
-        sendRestRequest("DELETE", std::string("/channels/") + std::to_string(channelId) + "/messages/bulk-delete",
+        sendRestRequest(Routes::deleteMessages.format(channelId),
                         {{ "messages", messageIds }});
     }
 
     void RestClient::addReaction(Snowflake channelId, Snowflake messageId, Snowflake emojiId) {
-        sendRestRequest("PUT", std::string("/channels/") + std::to_string(channelId) +
-                                           "/messages/"  + std::to_string(messageId) +
-                                           "/reactions/" + std::to_string(emojiId)   +
-                                           "/@me");
+        sendRestRequest(Routes::addReaction.format(channelId, messageId, emojiId));
     }
 
     void RestClient::removeReaction(Snowflake channelId, Snowflake messageId, Snowflake emojiId, Snowflake userId) {
-        sendRestRequest("DELETE", std::string("/channels/") + std::to_string(channelId) +
-                                              "/messages/"  + std::to_string(messageId) +
-                                              "/reactions/" + std::to_string(emojiId)   +
-                                             (userId ? std::to_string(userId) : std::string("/@me")));
+        sendRestRequest(userId ? Routes::deleteUserReaction.format(channelId, messageId, emojiId, userId)
+                               : Routes::deleteOwnReaction.format(channelId, messageId, emojiId));
     }
 
     nlohmann::json RestClient::getReactions(Snowflake channelId, Snowflake messageId, Snowflake emojiId) {
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId) +
-                                                  "/messages/"  + std::to_string(messageId) +
-                                                  "/reactions/" + std::to_string(emojiId));
+        return sendRestRequest(Routes::getReactions.format(channelId, messageId, emojiId));
     }
 
     void RestClient::resetReactions(Snowflake channelId, Snowflake messageId) {
-        sendRestRequest("DELETE", std::string("/channels/") + std::to_string(channelId) +
-                                              "/messages/"  + std::to_string(messageId) +
-                                              "/reactions");
+        sendRestRequest(Routes::resetReactions.format(channelId, messageId));
     }
 
     nlohmann::json RestClient::getGuild(Snowflake id) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(id));
+        return sendRestRequest(Routes::getGuild.format(id));
     }
 
     nlohmann::json RestClient::createGuild(const nlohmann::json& newGuildObject) {
-        return sendRestRequest("POST", "/guilds", newGuildObject);
+        return sendRestRequest(Routes::createGuild.format(), newGuildObject);
     }
 
     nlohmann::json RestClient::modifyGuild(Snowflake id, const nlohmann::json& changedFields) {
-        return sendRestRequest("PATCH", std::string("/guilds/") + std::to_string(id), changedFields);
+        return sendRestRequest(Routes::modifyGuild.format(id), changedFields);
     }
 
     nlohmann::json RestClient::getBans(Snowflake guildId) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(guildId) +
-                                                  "/bans");
+        return sendRestRequest(Routes::getBans.format(guildId));
     }
 
     void RestClient::banMember(Snowflake guildId, Snowflake userId, unsigned deleteMessagesDays) {
-        sendRestRequest("PUT", std::string("/guilds/") + std::to_string(guildId) +
-                                           "/bans"     + std::to_string(userId),
+        sendRestRequest(Routes::banMember.format(guildId, userId),
                         {}, {{ "delete-message-days", std::to_string(deleteMessagesDays) }});
     }
 
     void RestClient::unbanMember(Snowflake guildId, Snowflake userId) {
-        sendRestRequest("DELETE", std::string("/guilds/") + std::to_string(guildId) +
-                                              "/bans"     + std::to_string(userId));
+        sendRestRequest(Routes::unbanMember.format(guildId, userId));
     }
 
     void RestClient::kickMember(Snowflake guildId, Snowflake userId) {
-        sendRestRequest("DELETE", std::string("/guilds/") + std::to_string(guildId) +
-                                              "/members"  + std::to_string(userId));
+        sendRestRequest(Routes::kickMember.format(guildId, userId));
     }
 
     nlohmann::json RestClient::getChannels(Snowflake guildId) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(guildId) +
-                                                  "/channels");
+        return sendRestRequest(Routes::getChannels.format(guildId));
     }
 
     nlohmann::json RestClient::getMembers(Snowflake guildId, unsigned limit, Snowflake after) {
-        return sendRestRequest(std::string("/guilds/") + std::to_string(guildId) + "/members", {},
+        return sendRestRequest(Routes::getMembers.format(guildId),
                                {}, {{ "limit", std::to_string(limit) }, { "after", std::to_string(after) }});
     }
 
     nlohmann::json RestClient::getMember(Snowflake guildId, Snowflake userId) {
-        return sendRestRequest("GET", std::string("/guilds/") +  std::to_string(guildId) +
-                                                  "/members/" +  std::to_string(userId));
+        return sendRestRequest(Routes::getMember.format(guildId, userId));
     }
 
     void RestClient::setMemberNickname(Snowflake guildId, Snowflake userId, const std::string& newNick) {
-        sendRestRequest("PATCH", std::string("/guilds")  + std::to_string(guildId) +
-                                             "/members/" + std::to_string(userId),
+        sendRestRequest(Routes::modifyMember.format(guildId, userId),
                         {{ "nick", newNick }});
     }
 
     void RestClient::setMemberRoles(Snowflake guildId, Snowflake userId, const std::vector<Snowflake>& newRoles) {
-        sendRestRequest("PATCH", std::string("/guilds")  + std::to_string(guildId) +
-                                             "/members/" + std::to_string(userId),
+        sendRestRequest(Routes::modifyMember.format(guildId, userId),
                         {{ "roles", newRoles }});
     }
 
     void RestClient::setMemberMute(Snowflake guildId, Snowflake userId, bool muted) {
-        sendRestRequest("PATCH", std::string("/guilds")  + std::to_string(guildId) +
-                                             "/members/" + std::to_string(userId),
+        sendRestRequest(Routes::modifyMember.format(guildId, userId),
                         {{ "mute", muted }});
     }
 
     void RestClient::setMemberDeaf(Snowflake guildId, Snowflake userId, bool deafen) {
-        sendRestRequest("PATCH", std::string("/guilds")  + std::to_string(guildId) +
-                                             "/members/" + std::to_string(userId),
+        sendRestRequest(Routes::modifyMember.format(guildId, userId),
                         {{ "deaf", deafen }});
     }
 
     void RestClient::moveMember(Snowflake guildId, Snowflake userId, Snowflake targetChannel) {
-        sendRestRequest("PATCH", std::string("/guilds")  + std::to_string(guildId) +
-                                             "/members/" + std::to_string(userId),
+        sendRestRequest(Routes::modifyMember.format(guildId, userId),
                         {{ "channel_id", targetChannel }});
     }
 
     nlohmann::json RestClient::getGuildIntegrations(Snowflake guildId) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(guildId) +
-                                                  "/integrations");
+        return sendRestRequest(Routes::getGuildIntegrations.format(guildId));
     }
 
     void RestClient::attachIntegration(Snowflake guildId, const std::string& type, Snowflake integrationId) {
-        sendRestRequest("POST", std::string("/guilds/") + std::to_string(guildId) +
-                                            "/integrations",
+        sendRestRequest(Routes::attachIntegration.format(guildId),
                         {{ "type", type }, { "id", integrationId }});
     }
 
     void RestClient::detachIntegration(Snowflake guildId, Snowflake integrationId) {
-        sendRestRequest("DELETE", std::string("/guilds/")      + std::to_string(guildId) +
-                                              "/integrations/" + std::to_string(integrationId));
+        sendRestRequest(Routes::detachIntegration.format(guildId, integrationId));
     }
 
     void RestClient::syncIntegration(Snowflake guildId, Snowflake integrationId) {
-        sendRestRequest("POST", std::string("/guilds/")      + std::to_string(guildId) +
-                                            "/integrations/" + std::to_string(integrationId) +
-                                            "/sync");
+        sendRestRequest(Routes::syncIntegration.format(guildId, integrationId));
     }
 
     nlohmann::json RestClient::getGuildEmbed(Snowflake guildId) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(guildId) +
-                                                  "/embed");
+        return sendRestRequest(Routes::getGuildEmbed.format(guildId));
     }
 
     void RestClient::modifyGuildEmbed(Snowflake guildId, bool enabled, Snowflake channelId) {
-        sendRestRequest("PATCH", std::string("/guilds/") + std::to_string(guildId) +
-                                             "/embed", {{ "enabled", enabled }, { "channel_id", channelId }});
+        sendRestRequest(Routes::modifyGuildEmbed.format(guildId), {{ "enabled", enabled }, { "channel_id", channelId }});
     }
 
     nlohmann::json RestClient::createChannel(Snowflake guildId, const nlohmann::json& channelFields) {
-        return sendRestRequest("POST", std::string("/guilds/") + std::to_string(guildId) +
-                                                   "/channels", channelFields);
+        return sendRestRequest(Routes::createChannel.format(guildId), channelFields);
     }
 
     void RestClient::reorderChannels(Snowflake guildId, const std::vector<std::pair<Snowflake, unsigned>>& newPositions) {
@@ -464,8 +657,7 @@ namespace Hexicord {
         for (const auto& pair : newPositions) {
             payload.push_back({{ "id", pair.first }, { "position", pair.second }});
         }
-        sendRestRequest("PATCH", std::string("/guilds/") + std::to_string(guildId) +
-                                             "/channels");
+        sendRestRequest(Routes::reorderChannels.format(guildId));
     }
 
     void RestClient::reorderRoles(Snowflake guildId, const std::vector<std::pair<Snowflake, unsigned>>& newPositions) {
@@ -473,50 +665,41 @@ namespace Hexicord {
         for (const auto& pair : newPositions) {
             payload.push_back({{ "id", pair.first }, { "position", pair.second }});
         }
-        sendRestRequest("PATCH", std::string("/guilds/") + std::to_string(guildId) +
-                                             "/roles");
+        sendRestRequest(Routes::reorderRoles.format(guildId));
     }
 
     nlohmann::json RestClient::getRoles(Snowflake guildId) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(guildId) +
-                                                  "/roles");
+        return sendRestRequest(Routes::getRoles.format(guildId));
     }
 
     nlohmann::json RestClient::createRole(Snowflake guildId, const nlohmann::json& roleObject) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(guildId) +
-                                                  "/roles", roleObject);
+        return sendRestRequest(Routes::createRole.format(guildId), roleObject);
     }
 
     nlohmann::json RestClient::modifyRole(Snowflake guildId, Snowflake roleId,
                                           const nlohmann::json& updatedFields) {
-        return sendRestRequest("PATCH", std::string("/guilds/") + std::to_string(guildId) +
-                                                    "/roles"    + std::to_string(roleId),
+        return sendRestRequest(Routes::modifyRole.format(guildId, roleId),
                                updatedFields);
     }
 
     void RestClient::deleteRole(Snowflake guildId, Snowflake roleId) {
-        sendRestRequest("DELETE", std::string("/guilds/") + std::to_string(guildId) +
-                                              "/roles"    + std::to_string(roleId));
+        sendRestRequest(Routes::deleteRole.format(guildId, roleId));
     }
 
     void RestClient::giveRole(Snowflake guildId, Snowflake userId, Snowflake roleId) {
-        sendRestRequest("PUT", std::string("/guilds/") + std::to_string(guildId) +
-                                           "/members/" + std::to_string(userId) +
-                                           "/roles/"   + std::to_string(roleId));
+        sendRestRequest(Routes::giveRole.format(guildId, userId, roleId));
     }
 
     void RestClient::takeRole(Snowflake guildId, Snowflake userId, Snowflake roleId) {
-        sendRestRequest("DELETE", std::string("/guilds/") + std::to_string(guildId) +
-                                              "/members/" + std::to_string(userId) +
-                                              "/roles/"   + std::to_string(roleId));
+        sendRestRequest(Routes::takeRole.format(guildId, userId, roleId));
     }
 
     nlohmann::json RestClient::getMe() {
-        return sendRestRequest("GET", std::string("/users/@me"));
+        return sendRestRequest(Routes::getMe.format());
     }
 
     nlohmann::json RestClient::getUser(Snowflake id) {
-        return sendRestRequest("GET", std::string("/users/") + std::to_string(id));
+        return sendRestRequest(Routes::getUser.format(id));
     }
 
     nlohmann::json RestClient::setUsername(const std::string& newUsername) {
@@ -541,11 +724,11 @@ namespace Hexicord {
             }
         }
 
-        return sendRestRequest("PATCH", "/users/@me", {{ "username", newUsername }});
+        return sendRestRequest(Routes::modifyMe.format(), {{ "username", newUsername }});
     }
 
     nlohmann::json RestClient::setAvatar(const Image& image) {
-        return sendRestRequest("PATCH", "/users/@me", {{ "avatar", image.toAvatarData() }});
+        return sendRestRequest(Routes::modifyMe.format(), {{ "avatar", image.toAvatarData() }});
     }
 
     nlohmann::json RestClient::getUserGuilds(unsigned short limit, Snowflake startId, bool before) {
@@ -556,53 +739,51 @@ namespace Hexicord {
         if (startId != 0) {
             query.insert({ before ? "before" : "after", std::to_string(startId) });
         }
-        return sendRestRequest("GET", "/users/@me/guilds", {}, query);
+        return sendRestRequest(Routes::getUserGuilds.format(), {}, query);
     }
 
     void RestClient::leaveGuild(Snowflake guildId) {
-        sendRestRequest("DELETE", std::string("/users/@me/guilds/") + std::to_string(guildId));
+        sendRestRequest(Routes::leaveGuild.format(guildId));
     }
 
     nlohmann::json RestClient::getUserDms() {
-        return sendRestRequest("GET", "/users/@me/channels");
+        return sendRestRequest(Routes::getUserDms.format());
     }
 
     nlohmann::json RestClient::createDm(Snowflake recipientId) {
-        return sendRestRequest("POST", "/users/@me/channels", {{ "recipient_id", recipientId }});
+        return sendRestRequest(Routes::createDm.format(), {{ "recipient_id", recipientId }});
     }
 
 
     nlohmann::json RestClient::createGroupDm(const std::vector<Snowflake>& accessTokens,
                                          const std::unordered_map<Snowflake, std::string>& nicks) {
 
-        return sendRestRequest("POST", "/users/@me/channels", {{ "access_tokens", accessTokens },
-                                                               { "nicks",         nicks        }});
+        return sendRestRequest(Routes::createDm.format(), {{ "access_tokens", accessTokens },
+                                                           { "nicks",         nicks        }});
     }
 
     nlohmann::json RestClient::getConnections() {
-        return sendRestRequest("GET", "/users/@me/connections");
+        return sendRestRequest(Routes::getConnections.format());
     }
 
     nlohmann::json RestClient::getInvites(Snowflake guildId) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(guildId) +
-                                                  "/invites");
+        return sendRestRequest(Routes::getInvites.format(guildId));
     }
 
     nlohmann::json RestClient::getInvite(const std::string& inviteCode) {
-        return sendRestRequest("GET", std::string("/invites/") + inviteCode);
+        return sendRestRequest(Routes::getInvite.format(inviteCode));
     }
 
     nlohmann::json RestClient::revokeInvite(const std::string& inviteCode) {
-        return sendRestRequest("DELETE", std::string("/invites/") + inviteCode);
+        return sendRestRequest(Routes::revokeInvite.format(inviteCode));
     }
 
     nlohmann::json RestClient::acceptInvite(const std::string& inviteCode) {
-        return sendRestRequest("POST", std::string("/invites/") + inviteCode);
+        return sendRestRequest(Routes::acceptInvite.format(inviteCode));
     }
 
     nlohmann::json RestClient::getChannelInvites(Snowflake channelId) {
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId) +
-                                                  "/invites");
+        return sendRestRequest(Routes::getChannelInvites.format(channelId));
     }
 
     nlohmann::json RestClient::createInvite(Snowflake channelId, unsigned maxAgeSecs,
@@ -614,21 +795,19 @@ namespace Hexicord {
         if (temporaryMembership)  payload["temporary_membership"] = true;
         if (unique)               payload["unique"]               = true;
 
-        return sendRestRequest("DELETE", std::string("/channels") + std::to_string(channelId), payload);
+        return sendRestRequest(Routes::createInvite.format(channelId), payload);
     }
 
     nlohmann::json RestClient::getWebhook(Snowflake id) {
-        return sendRestRequest("GET", std::string("/webhooks/") + std::to_string(id));
+        return sendRestRequest(Routes::getWebhook.format(id));
     }
 
     nlohmann::json RestClient::getChannelWebhooks(Snowflake channelId) {
-        return sendRestRequest("GET", std::string("/channels/") + std::to_string(channelId) +
-                                                  "/webhooks");
+        return sendRestRequest(Routes::getChannelWebhooks.format(channelId));
     }
 
     nlohmann::json RestClient::getGuildWebhooks(Snowflake guildId) {
-        return sendRestRequest("GET", std::string("/guilds/") + std::to_string(guildId) +
-                                                  "/webhooks");
+        return sendRestRequest(Routes::getGuildWebhooks.format(guildId));
     }
 
     nlohmann::json RestClient::createWebhook(Snowflake channelId, const std::string& name, const boost::optional<Image>& avatar) {
@@ -640,7 +819,7 @@ namespace Hexicord {
         if (avatar) {
             payload["avatar"] = avatar->toAvatarData();
         }
-        return sendRestRequest("POST", std::string("/channels/") + std::to_string(channelId) + "/webhooks",
+        return sendRestRequest(Routes::createWebhook.format(channelId),
                                payload);
     }
 
@@ -648,16 +827,16 @@ namespace Hexicord {
         if (newName.size() == 1 || newName.size() > 32) {
             throw InvalidParameter("name", "size out of range (should be 2-32)");
         }
-        return sendRestRequest("PATCH", std::string("/webhooks/") + std::to_string(id), {{ "name", newName }});
+        return sendRestRequest(Routes::modifyWebhook.format(id), {{ "name", newName }});
     }
 
     nlohmann::json RestClient::setWebhookAvatar(Snowflake id, const Image& avatar) {
-        return sendRestRequest("PATCH", std::string("/webhooks/") + std::to_string(id),
+        return sendRestRequest(Routes::modifyWebhook.format(id),
                                {{ "avatar", avatar.toAvatarData() }});
     }
 
     void RestClient::deleteWebhook(Snowflake id) {
-        sendRestRequest("DELETE", std::string("/webhooks/") + std::to_string(id));
+        sendRestRequest(Routes::deleteWebhook.format(id));
     }
 
     void RestClient::prepareRequestBody(REST::HTTPRequest& request,
@@ -670,10 +849,7 @@ namespace Hexicord {
 
             request.headers.emplace("Content-Type", "application/json");
 
-            std::string jsonStr = payload.dump();
-            std::vector<uint8_t> payloadBytes(jsonStr.begin(), jsonStr.end());
-
-            request.body = payloadBytes;
+            request.body.emplace_back(payload.dump());
         } else {
             std::vector<REST::MultipartEntity> actualMultipartElements;
             actualMultipartElements.reserve(elements.size() + 1);
@@ -685,18 +861,35 @@ namespace Hexicord {
                         /* name:              */ "payload_json",
                         /* filename:          */ "",
                         /* additionalHeaders: */ {{ "Content-Type", "application/json" }},
-                        /* body               */ std::vector<uint8_t>(bodyStr.begin(), bodyStr.end())
+                        /* body               */ SharedBuffer(std::move(bodyStr))
                         });
             }
 
+            // Cheap, entity bodies are shared.
             for (const auto& element : elements) actualMultipartElements.push_back(element);
 
             REST::HTTPRequest tempRequest = REST::buildMultipartRequest(actualMultipartElements);
             request.headers["Content-Type"] = tempRequest.headers["Content-Type"];
-            request.body                    = tempRequest.body;
+            request.body                    = std::move(tempRequest.body);
         }
     }
 
+    REST::HTTPRequest RestClient::buildRequest(const std::string& method, const std::string& endpoint,
+                                               const nlohmann::json& payload,
+                                               const std::unordered_map<std::string, std::string>& query,
+                                               const std::vector<REST::MultipartEntity>& multipart) {
+        REST::HTTPRequest request;
+
+        request.method  = method;
+        request.path    = restBasePath + endpoint + Utils::makeQueryString(query);
+        request.version = 11;
+
+        prepareRequestBody(request, payload, multipart);
+
+        request.headers.insert({ "Accept", "application/json" });
+        return request;
+    }
+
     void RestClient::throwRestError(const REST::HTTPResponse& response,
                                 const nlohmann::json& payload) {
 
@@ -739,22 +932,6 @@ namespace Hexicord {
             throw RESTError("Unknown error");
     }
 
-#ifdef HEXICORD_RATELIMIT_PREDICTION 
-    void RestClient::updateRatelimitsIfPresent(const std::string& endpoint, const REST::HeadersMap& headers) {
-        auto remainingIt = headers.find("X-RateLimit-Remaining");
-        auto limitIt     = headers.find("X-RateLimit-Limit");
-        auto resetIt     = headers.find("X-RateLimit-Reset");
-
-        unsigned remaining  =  remainingIt  !=  headers.end() ? std::stoi(remainingIt->second)  : 0;
-        unsigned limit      =  limitIt      !=  headers.end() ? std::stoi(limitIt->second)      : 0;
-        time_t reset        =  resetIt      !=  headers.end() ? std::stoll(resetIt->second)     : 0;
-
-        if (remaining && limit && reset) {
-            ratelimitLock.refreshInfo(Utils::getRatelimitDomain(endpoint), remaining, limit, reset);
-        }
-    }
-#endif // HEXICORD_RATELIMIT_PREDICTION
-
     REST::MultipartEntity RestClient::fileToMultipartEntity(const File& file) {
         return {
                 /* name:              */ file.filename,
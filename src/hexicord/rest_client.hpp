@@ -22,17 +22,19 @@
 #ifndef HEXICORD_REST_CLIENT_HPP
 #define HEXICORD_REST_CLIENT_HPP
 
+#include <exception>
+#include <functional>
+#include <memory>
 #include <utility>
 #include <boost/asio/io_service.hpp>
 #include <boost/optional.hpp>
 #include <hexicord/permission.hpp>
 #include <hexicord/json.hpp>
 #include <hexicord/internal/rest.hpp>
+#include <hexicord/internal/route.hpp>
 #include <hexicord/config.hpp>
 #include <hexicord/types.hpp>
-#ifdef HEXICORD_RATELIMIT_PREDICTION
-    #include <hexicord/ratelimit_lock.hpp>
-#endif
+#include <hexicord/ratelimit_scheduler.hpp>
 
 namespace Hexicord {
 
@@ -47,8 +49,13 @@ namespace Hexicord {
          * \param token     token string, will be interpreted as OAuth or Bot token
          *                  depending on future calls, don't add "Bearer " or
          *                  "Bot " prefix.
+         * \param maxConnections Limit of simultaneous connections used by
+         *                  asynchronous requests (see \ref REST::HTTPSConnectionPool).
+         *
+         * RestClient can be used by many threads at once, connections and
+         * rate-limit state are shared.
          */
-        RestClient(boost::asio::io_service& ioService, const std::string& token);
+        RestClient(boost::asio::io_service& ioService, const std::string& token, size_t maxConnections = 4);
 
         RestClient(const RestClient&) = delete;
         RestClient(RestClient&&) = default;
@@ -100,6 +107,97 @@ namespace Hexicord {
                                        const std::unordered_map<std::string, std::string>& query = {},
                                        const std::vector<REST::MultipartEntity>& multipart = {});
 
+        /**
+         * Send REST-request to route formatted from \ref REST::RouteTemplate.
+         * Unlike string version, rate-limit bucket is taken from template
+         * instead of being guessed from path.
+         *
+         * \ingroup REST
+         */
+        nlohmann::json sendRestRequest(const REST::Route& route,
+                                       const nlohmann::json& payload = {},
+                                       const std::unordered_map<std::string, std::string>& query = {},
+                                       const std::vector<REST::MultipartEntity>& multipart = {});
+
+        /**
+         * Called when asynchronous REST request finishes. On success error is
+         * null and response contains result JSON (null if there is no body),
+         * otherwise error contains exception that would be thrown by
+         * synchronous version.
+         */
+        using RestHandler = std::function<void(std::exception_ptr error, nlohmann::json response)>;
+
+        /**
+         * Asynchronous version of \ref sendRestRequest.
+         *
+         * Returns immediately, request is performed as I/O service completions,
+         * so it's safe to call from gateway event handlers. Up to maxConnections
+         * requests are performed in parallel using pooled keep-alive connections,
+         * others wait for free connection, so order of completion is not
+         * guaranteed. Requests are queued per rate-limit bucket and released
+         * using timers instead of blocking.
+         *
+         * handler is invoked from I/O service thread. RestClient should not be
+         * destroyed or moved while requests are pending. Like synchronous
+         * methods, asynchronous methods can be called from any thread.
+         *
+         * \ingroup REST
+         */
+        void asyncSendRestRequest(const std::string& method, const std::string& endpoint, RestHandler handler,
+                                  const nlohmann::json& payload = {},
+                                  const std::unordered_map<std::string, std::string>& query = {},
+                                  const std::vector<REST::MultipartEntity>& multipart = {});
+
+        /**
+         * Asynchronous version of \ref sendRestRequest taking \ref REST::Route.
+         *
+         * \ingroup REST
+         */
+        void asyncSendRestRequest(const REST::Route& route, RestHandler handler,
+                                  const nlohmann::json& payload = {},
+                                  const std::unordered_map<std::string, std::string>& query = {},
+                                  const std::vector<REST::MultipartEntity>& multipart = {});
+
+        /**
+         * \defgroup REST_async Asynchronous methods
+         *
+         * Asynchronous versions of most frequently used methods, see
+         * \ref asyncSendRestRequest for notes. Parameters are validated
+         * before queuing request, so InvalidParameter is still thrown
+         * synchronously. Other requests can be made using
+         * \ref asyncSendRestRequest directly.
+         *
+         * @{
+         */
+
+        /// Asynchronous version of \ref getChannel.
+        void asyncGetChannel(Snowflake channelId, RestHandler handler);
+
+        /// Asynchronous version of \ref getMessage.
+        void asyncGetMessage(Snowflake channelId, Snowflake messageId, RestHandler handler);
+
+        /// Asynchronous version of \ref sendTextMessage.
+        void asyncSendTextMessage(Snowflake channelId, const std::string& text, RestHandler handler,
+                                  const nlohmann::json& embed = nullptr, bool tts = false);
+
+        /// Asynchronous version of \ref sendFile.
+        void asyncSendFile(Snowflake channelId, const File& file, RestHandler handler);
+
+        /// Asynchronous version of \ref editMessage.
+        void asyncEditMessage(Snowflake channelId, Snowflake messageId, const std::string& text,
+                              RestHandler handler, const nlohmann::json& embed = nullptr);
+
+        /// Asynchronous version of \ref deleteMessage.
+        void asyncDeleteMessage(Snowflake channelId, Snowflake messageId, RestHandler handler);
+
+        /// Asynchronous version of \ref addReaction.
+        void asyncAddReaction(Snowflake channelId, Snowflake messageId, Snowflake emojiId, RestHandler handler);
+
+        /// Asynchronous version of \ref triggerTypingIndicator.
+        void asyncTriggerTypingIndicator(Snowflake channelId, RestHandler handler);
+
+        /// @} REST_async
+
         /** \defgroup REST REST methods
          *
          * Functions for performing requests to REST endpoints.
@@ -336,6 +434,10 @@ namespace Hexicord {
          *         user accounts with Discord Nitro have 50 MB limit. If you send
          *         a file bigger than allowed, you will get RESTError with 40005 code.
          *
+         * File contents are written to socket directly from \ref File::bytes,
+         * so large files can be sent from \ref File::map without reading them
+         * into memory first.
+         *
          * \returns Message object that represents sent message.
          *
          * \sa \ref sendTextMessage
@@ -942,9 +1044,10 @@ namespace Hexicord {
         /// @} REST
 
 
-#ifdef HEXICORD_RATELIMIT_PREDICTION
-        RatelimitLock ratelimitLock;
-#endif
+        /**
+         * Rate-limit state shared by synchronous and asynchronous requests.
+         */
+        const RatelimitScheduler& ratelimits() const { return *ratelimitScheduler; }
 
         /**
          * Used authorization token.
@@ -957,17 +1060,31 @@ private:
                                 const nlohmann::json& payload,
                                 const std::vector<REST::MultipartEntity>& elements);
 
+        REST::HTTPRequest buildRequest(const std::string& method, const std::string& endpoint,
+                                       const nlohmann::json& payload,
+                                       const std::unordered_map<std::string, std::string>& query,
+                                       const std::vector<REST::MultipartEntity>& multipart);
+
         // Throws RESTError or inherited class.
         void throwRestError(const REST::HTTPResponse& response, const nlohmann::json& payload);
 
-#ifdef HEXICORD_RATELIMIT_PREDICTION
-        void updateRatelimitsIfPresent(const std::string& endpoint, const REST::HeadersMap& headers);
-#endif
-
         static inline REST::MultipartEntity fileToMultipartEntity(const File& file);
 
-        std::unique_ptr<REST::HTTPSConnection> restConnection;
+        std::unique_ptr<REST::HTTPSConnectionPool> restPool;
         boost::asio::io_service& ioService; // non-owning reference to I/O service.
+        std::unique_ptr<RatelimitScheduler> ratelimitScheduler;
+
+        struct PendingRequest {
+            REST::HTTPRequest request;
+            std::string path;     // without query.
+            std::string bucket;   // see REST::Route::bucket.
+            RestHandler handler;
+        };
+
+        void asyncSchedule(std::shared_ptr<PendingRequest> pending);
+        void asyncPerform(std::shared_ptr<PendingRequest> pending);
+        void asyncHandleResponse(std::shared_ptr<PendingRequest> pending, const REST::HTTPResponse& response);
+        void asyncFinish(std::shared_ptr<PendingRequest> pending, std::exception_ptr error, nlohmann::json response);
     };
 }
 
@@ -0,0 +1,249 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <hexicord/shard_manager.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef HEXICORD_DEBUG_LOG
+    #include <iostream>
+    #define DEBUG_MSG(msg) do { std::cerr <<  "shard_manager.cpp:" << __LINE__ << " " << (msg) << '\n'; } while (false)
+#else
+    #define DEBUG_MSG(msg)
+#endif
+
+namespace Hexicord {
+
+constexpr unsigned ShardManager::identifyIntervalMs;
+
+ShardManager::ShardManager(const std::string& token, int shardCount, unsigned threadsCount,
+                           GatewayClient::Encoding encoding)
+    : token(token) {
+
+    if (shardCount <= 0) throw std::invalid_argument("shardCount must be positive");
+
+    if (threadsCount == 0) threadsCount = std::max(1u, std::thread::hardware_concurrency());
+    threadsCount = std::min(threadsCount, unsigned(shardCount));
+
+    for (unsigned i = 0; i < threadsCount; ++i) {
+        ioServices.emplace_back(new boost::asio::io_service);
+    }
+
+    for (int shardId = 0; shardId < shardCount; ++shardId) {
+        shards.emplace_back(new Shard(*ioServices[shardId % threadsCount], token, encoding));
+
+        Shard& shard = *shards.back();
+        shard.client.beforeIdentify = [this, &shard](std::function<void()> proceed) {
+            if (shard.status == ShardStatus::Stopped) return proceed();
+
+            shard.status = ShardStatus::Queued;
+            shard.identifyTimer.expires_at(reserveIdentifySlot());
+            shard.identifyTimer.async_wait([&shard, proceed](const boost::system::error_code& ec) {
+                // Proceed even if timer is cancelled by stop(), GatewayClient
+                // will report aborted connection then. Stopped status is kept.
+                if (ec != boost::asio::error::operation_aborted && shard.status != ShardStatus::Stopped) {
+                    shard.status = ShardStatus::Connecting;
+                }
+                proceed();
+            });
+        };
+
+        // Status is also updated this way after automatic reconnection.
+        auto markConnected = [&shard](const GatewayJson&) {
+            shard.status = ShardStatus::Connected;
+        };
+        shard.client.eventDispatcher.addHandler(Event::Ready,   markConnected);
+        shard.client.eventDispatcher.addHandler(Event::Resumed, markConnected);
+
+        shard.client.onRecoveryFailure = [this, shardId, &shard](std::exception_ptr error, bool willRetry) {
+            if (shard.status == ShardStatus::Stopped) return;
+
+            try {
+                std::rethrow_exception(error);
+            } catch (std::exception& excp) {
+                DEBUG_MSG(std::string("Shard ") + std::to_string(shardId) + " failed to reconnect: " + excp.what());
+                setError(shardId, excp.what());
+            } catch (...) {
+                setError(shardId, "Unknown error during connection recovery");
+            }
+
+            if (willRetry) {
+                // Client retries by itself after backoff.
+                shard.status = ShardStatus::Connecting;
+                return;
+            }
+
+            // Client gave up, start over with new session (waits for identify slot).
+            shard.status = ShardStatus::Connecting;
+            shard.ioService.post([this, shardId]() { connectShard(shardId, 0); });
+        };
+    }
+}
+
+ShardManager::~ShardManager() {
+    stop();
+}
+
+void ShardManager::addHandler(Event eventType, EventDispatcher::EventHandler handler) {
+    for (auto& shard : shards) {
+        shard->client.eventDispatcher.addHandler(eventType, handler);
+    }
+}
+
+void ShardManager::setExecutor(EventDispatcher::Executor executor, EventDispatcher::Ordering ordering) {
+    for (auto& shard : shards) {
+        shard->client.eventDispatcher.setExecutor(executor, ordering);
+    }
+}
+
+void ShardManager::start(const std::string& gatewayUrl, const nlohmann::json& initialPresence) {
+    if (running) throw std::logic_error("ShardManager is already running");
+
+    this->gatewayUrl      = gatewayUrl;
+    this->initialPresence = initialPresence;
+
+    DEBUG_MSG(std::string("Starting ") + std::to_string(shards.size()) + " shards using " +
+              std::to_string(ioServices.size()) + " threads...");
+
+    // Handshakes are done in parallel, identifies are spaced by beforeIdentify hook.
+    for (int shardId = 0; shardId < shardCount(); ++shardId) {
+        Shard& shard = *shards[shardId];
+        shard.status = ShardStatus::Connecting;
+        setError(shardId, "");
+
+        shard.ioService.post([this, shardId]() { connectShard(shardId, 0); });
+    }
+
+    for (auto& ioService : ioServices) {
+        ioService->reset();
+        works.emplace_back(new boost::asio::io_service::work(*ioService));
+        boost::asio::io_service& ioServiceRef = *ioService;
+        threads.emplace_back([&ioServiceRef]() { runIoService(ioServiceRef); });
+    }
+
+    running = true;
+}
+
+void ShardManager::stop() noexcept {
+    if (!running) return;
+
+    DEBUG_MSG("Stopping shards...");
+    for (auto& shardPtr : shards) {
+        Shard& shard = *shardPtr;
+        shard.ioService.post([&shard]() {
+            boost::system::error_code ec;
+            shard.identifyTimer.cancel(ec);
+            shard.retryTimer.cancel(ec);
+            // Also aborts connection in progress.
+            shard.client.disconnect(shard.status == ShardStatus::Connected ? 2000 : GatewayClient::NoCloseEvent);
+            shard.status = ShardStatus::Stopped;
+        });
+    }
+
+    // Threads exit once all pending operations are finished.
+    works.clear();
+    for (auto& thread : threads) {
+        if (thread.joinable()) thread.join();
+    }
+    threads.clear();
+
+    running = false;
+}
+
+ShardStatus ShardManager::status(int shardId) const {
+    return shards.at(shardId)->status;
+}
+
+std::string ShardManager::lastError(int shardId) const {
+    std::lock_guard<std::mutex> lock(errorsMutex);
+    return shards.at(shardId)->lastError;
+}
+
+GatewayClient& ShardManager::shard(int shardId) {
+    return shards.at(shardId)->client;
+}
+
+boost::asio::io_service& ShardManager::shardIoService(int shardId) {
+    return shards.at(shardId)->ioService;
+}
+
+std::chrono::steady_clock::time_point ShardManager::reserveIdentifySlot() {
+    std::lock_guard<std::mutex> lock(identifyMutex);
+
+    auto slot = std::max(nextIdentify, std::chrono::steady_clock::now());
+    nextIdentify = slot + std::chrono::milliseconds(identifyIntervalMs);
+    return slot;
+}
+
+void ShardManager::connectShard(int shardId, unsigned attempt) {
+    Shard& shard = *shards[shardId];
+    if (shard.status == ShardStatus::Stopped) return;
+
+    DEBUG_MSG(std::string("Connecting shard ") + std::to_string(shardId) + "...");
+    shard.client.asyncConnect(gatewayUrl, [this, shardId, attempt, &shard](std::exception_ptr error) {
+        if (!error || shard.status == ShardStatus::Stopped) return;
+
+        try {
+            std::rethrow_exception(error);
+        } catch (std::exception& excp) {
+            DEBUG_MSG(std::string("Shard ") + std::to_string(shardId) + " failed to connect: " + excp.what());
+            setError(shardId, excp.what());
+        } catch (...) {
+            setError(shardId, "Unknown error during connection");
+        }
+
+        // Same limit and backoff as used by client for connection recovery.
+        unsigned maxAttempts = shard.client.maxRecoveryAttempts;
+        if (maxAttempts != 0 && attempt + 1 >= maxAttempts) {
+            shard.status = ShardStatus::Failed;
+            return;
+        }
+
+        shard.status = ShardStatus::Connecting;
+        unsigned delayMs = 1000u << std::min(attempt, 6u);
+        shard.retryTimer.expires_from_now(std::chrono::milliseconds(std::min(delayMs, 60000u)));
+        shard.retryTimer.async_wait([this, shardId, attempt](const boost::system::error_code& ec) {
+            if (ec) return; // cancelled by stop().
+            connectShard(shardId, attempt + 1);
+        });
+    }, shardId, shardCount(), initialPresence);
+}
+
+void ShardManager::setError(int shardId, const std::string& error) {
+    std::lock_guard<std::mutex> lock(errorsMutex);
+    shards[shardId]->lastError = error;
+}
+
+void ShardManager::runIoService(boost::asio::io_service& ioService) {
+    // Exception thrown from handler unwinds run(), but other
+    // shards on this thread should keep working.
+    while (true) {
+        try {
+            ioService.run();
+            return;
+        } catch (std::exception& excp) {
+            DEBUG_MSG(std::string("Exception escaped shard I/O service: ") + excp.what());
+        }
+    }
+}
+
+} // namespace Hexicord
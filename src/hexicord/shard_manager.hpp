@@ -0,0 +1,198 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_SHARD_MANAGER_HPP
+#define HEXICORD_SHARD_MANAGER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <hexicord/json.hpp>
+#include <hexicord/event_dispatcher.hpp>
+#include <hexicord/gateway_client.hpp>
+
+namespace Hexicord {
+    enum class ShardStatus {
+        Stopped,    ///< Not started or disconnected by \ref ShardManager::stop.
+        Queued,     ///< Waiting for it's turn to identify.
+        Connecting, ///< Handshake and identify in progress.
+        Connected,  ///< Received Ready or Resumed event.
+        Failed      ///< Connection failed, see \ref ShardManager::lastError.
+    };
+
+    /**
+     * Runs several gateway connections (shards) of single bot
+     * using fixed number of threads.
+     *
+     * Each thread owns one io_service, shards are distributed across them
+     * in round-robin fashion, so all I/O of each shard always happens on
+     * the same thread (as required by \ref GatewayClient) and handlers of
+     * shard are never invoked concurrently.
+     *
+     * Shards are connected using \ref GatewayClient::asyncConnect, so
+     * threads are never blocked by connecting or reconnecting shard.
+     * Identify payloads of all shards are spaced by \ref identifyIntervalMs
+     * (including ones sent during connection recovery) using timers.
+     *
+     * Failed connection attempts are reported through \ref lastError and
+     * retried with the same backoff and limit as connection recovery (see
+     * \ref GatewayClient::maxRecoveryAttempts), shard is marked Failed once
+     * limit is reached. If shard's client gives up recovering (see
+     * \ref GatewayClient::onRecoveryFailure), new session is started.
+     */
+    class ShardManager {
+    public:
+        /**
+         * Minimal interval between two Identify payloads sent by bot.
+         */
+        static constexpr unsigned identifyIntervalMs = 5000;
+
+        /**
+         * Create shardCount shards (not connected) and threadsCount threads.
+         *
+         * threadsCount is capped to shardCount, 0 means "use hardware concurrency".
+         */
+        ShardManager(const std::string& token, int shardCount, unsigned threadsCount = 0,
+                     GatewayClient::Encoding encoding = GatewayClient::Encoding::Json);
+
+        /**
+         * Calls \ref stop.
+         */
+        ~ShardManager();
+
+        ShardManager(const ShardManager&) = delete;
+        ShardManager(ShardManager&&) = delete;
+
+        ShardManager& operator=(const ShardManager&) = delete;
+        ShardManager& operator=(ShardManager&&) = delete;
+
+        /**
+         * Add event handler to all shards.
+         *
+         * Handler will be invoked from different threads (one per io_service),
+         * so it should be thread-safe if it touches shared state.
+         *
+         * Should be called before \ref start.
+         */
+        void addHandler(Event eventType, EventDispatcher::EventHandler handler);
+
+        /**
+         * Set executor for all shards, see \ref EventDispatcher::setExecutor.
+         * Since events of one guild are always received by the same shard,
+         * one \ref DispatchPool can be shared by all shards.
+         *
+         * Should be called before \ref start.
+         */
+        void setExecutor(EventDispatcher::Executor executor,
+                         EventDispatcher::Ordering ordering = EventDispatcher::Ordering::PerGuild);
+
+        /**
+         * Start threads and schedule connection of all shards.
+         *
+         * Returns immediately, use \ref status to check state of individual
+         * shards. Connection errors are not thrown but reported through
+         * \ref status and \ref lastError.
+         */
+        void start(const std::string& gatewayUrl,
+                   const nlohmann::json& initialPresence = {{ "game", nullptr },
+                                                            { "status", "online" },
+                                                            { "since", nullptr },
+                                                            { "afk", false }});
+
+        /**
+         * Disconnect all shards and join threads.
+         */
+        void stop() noexcept;
+
+        ShardStatus status(int shardId) const;
+
+        /**
+         * Description of last error happened with shard, empty if none.
+         */
+        std::string lastError(int shardId) const;
+
+        /**
+         * Access shard's client.
+         *
+         * \warning Client is not thread-safe, post operations on it to
+         *          \ref shardIoService while manager is running.
+         */
+        GatewayClient& shard(int shardId);
+        boost::asio::io_service& shardIoService(int shardId);
+
+        inline int shardCount() const {
+            return int(shards.size());
+        }
+
+        inline unsigned threadsCount() const {
+            return unsigned(ioServices.size());
+        }
+    private:
+        struct Shard {
+            Shard(boost::asio::io_service& ioService, const std::string& token,
+                  GatewayClient::Encoding encoding)
+                : client(ioService, token, encoding)
+                , identifyTimer(ioService)
+                , retryTimer(ioService)
+                , ioService(ioService) {}
+
+            GatewayClient client;
+            boost::asio::steady_timer identifyTimer;
+            boost::asio::steady_timer retryTimer; // delays reconnection after failed connect.
+            boost::asio::io_service& ioService;
+            std::atomic<ShardStatus> status { ShardStatus::Stopped };
+            std::string lastError; // guarded by ShardManager::errorsMutex.
+        };
+
+        // Reserve next free identify slot and return time when it starts.
+        std::chrono::steady_clock::time_point reserveIdentifySlot();
+
+        // attempt is count of failed attempts before this one.
+        void connectShard(int shardId, unsigned attempt);
+        void setError(int shardId, const std::string& error);
+
+        // Body of each worker thread.
+        static void runIoService(boost::asio::io_service& ioService);
+
+        std::string token, gatewayUrl;
+        nlohmann::json initialPresence;
+        bool running = false;
+
+        std::mutex identifyMutex;
+        std::chrono::steady_clock::time_point nextIdentify;
+
+        mutable std::mutex errorsMutex;
+
+        // Order matters: shards must be destroyed before I/O services.
+        std::vector<std::unique_ptr<boost::asio::io_service>> ioServices;
+        std::vector<std::unique_ptr<boost::asio::io_service::work>> works;
+        std::vector<std::thread> threads;
+        std::vector<std::unique_ptr<Shard>> shards;
+    };
+}
+
+#endif // HEXICORD_SHARD_MANAGER_HPP
@@ -0,0 +1,472 @@
+// Hexicord - Discord API library for C++11 using boost libraries.
+// Copyright © 2017 Maks Mazurov (fox.cpp) <foxcpp@yandex.ru>
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef HEXICORD_SNOWFLAKE_MAP_HPP
+#define HEXICORD_SNOWFLAKE_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <hexicord/types/snowflake.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define HEXICORD_SNOWFLAKE_MAP_SSE2
+#   include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+/**
+ *  \file snowflake_map.hpp
+ *
+ *  Flat hash map with \ref Snowflake keys.
+ */
+
+namespace Hexicord {
+    namespace _detail {
+        // Control byte of each slot: empty, deleted or 7 bits of hash (full).
+        constexpr int8_t ctrlEmpty   = -128; // 0b10000000
+        constexpr int8_t ctrlDeleted = -2;   // 0b11111110
+
+        constexpr size_t groupWidth = 16;
+
+        inline unsigned countTrailingZeros(uint32_t value) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, value);
+            return unsigned(index);
+#else
+            return unsigned(__builtin_ctz(value));
+#endif
+        }
+
+        /**
+         * Control bytes of groupWidth consecutive slots, matched all at once.
+         * Returned masks have bit N set if slot N matches.
+         */
+        class Group {
+        public:
+#ifdef HEXICORD_SNOWFLAKE_MAP_SSE2
+            explicit Group(const int8_t* pos)
+                : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+            uint32_t match(int8_t hash) const {
+                return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(hash), ctrl)));
+            }
+
+            uint32_t matchEmpty() const {
+                return match(ctrlEmpty);
+            }
+
+            // Empty and deleted are the only values with high bit set.
+            uint32_t matchEmptyOrDeleted() const {
+                return uint32_t(_mm_movemask_epi8(ctrl));
+            }
+        private:
+            __m128i ctrl;
+#else
+            explicit Group(const int8_t* pos) {
+                std::memcpy(ctrl, pos, groupWidth);
+            }
+
+            uint32_t match(int8_t hash) const {
+                uint32_t result = 0;
+                for (size_t i = 0; i < groupWidth; ++i) {
+                    result |= uint32_t(ctrl[i] == hash) << i;
+                }
+                return result;
+            }
+
+            uint32_t matchEmpty() const {
+                return match(ctrlEmpty);
+            }
+
+            uint32_t matchEmptyOrDeleted() const {
+                uint32_t result = 0;
+                for (size_t i = 0; i < groupWidth; ++i) {
+                    result |= uint32_t(ctrl[i] < 0) << i;
+                }
+                return result;
+            }
+        private:
+            int8_t ctrl[groupWidth];
+#endif
+        };
+    } // namespace _detail
+
+    /**
+     * Open-addressing hash map with \ref Snowflake keys.
+     *
+     * Elements are stored in flat array, with separate array of one-byte
+     * control values holding 7 bits of hash for each slot. Lookup probes
+     * groups of 16 control bytes at once (using SSE2 where available) and
+     * compares keys only on match, so it rarely touches more than one cache
+     * line of elements. Keys are hashed using \ref hashSnowflake.
+     *
+     * Interface is a subset of std::unordered_map. Unlike it, any insertion
+     * may invalidate iterators and references to elements, erase invalidates
+     * only iterators and references to erased element.
+     */
+    template<typename T>
+    class SnowflakeMap {
+    public:
+        using key_type    = Snowflake;
+        using mapped_type = T;
+        using value_type  = std::pair<const Snowflake, T>;
+        using size_type   = size_t;
+
+        template<bool Const>
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = typename SnowflakeMap::value_type;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = typename std::conditional<Const, const value_type*, value_type*>::type;
+            using reference         = typename std::conditional<Const, const value_type&, value_type&>::type;
+
+            Iterator() = default;
+
+            // iterator -> const_iterator.
+            template<bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+            Iterator(const Iterator<OtherConst>& other)
+                : ctrl(other.ctrl), slot(other.slot), end(other.end) {}
+
+            reference operator*() const  { return *slot; }
+            pointer   operator->() const { return slot; }
+
+            Iterator& operator++() {
+                ++ctrl;
+                ++slot;
+                skipFree();
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                Iterator copy = *this;
+                ++*this;
+                return copy;
+            }
+
+            bool operator==(const Iterator& other) const { return ctrl == other.ctrl; }
+            bool operator!=(const Iterator& other) const { return ctrl != other.ctrl; }
+        private:
+            friend class SnowflakeMap;
+            template<bool> friend class Iterator;
+
+            Iterator(const int8_t* ctrl, pointer slot, const int8_t* end)
+                : ctrl(ctrl), slot(slot), end(end) {}
+
+            void skipFree() {
+                while (ctrl != end && *ctrl < 0) {
+                    ++ctrl;
+                    ++slot;
+                }
+            }
+
+            const int8_t* ctrl = nullptr;
+            pointer slot = nullptr;
+            const int8_t* end = nullptr;
+        };
+
+        using iterator       = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
+        SnowflakeMap() = default;
+
+        SnowflakeMap(const SnowflakeMap& other) {
+            reserve(other.size());
+            for (const auto& pair : other) emplace(pair.first, pair.second);
+        }
+
+        SnowflakeMap(SnowflakeMap&& other) noexcept {
+            swap(other);
+        }
+
+        SnowflakeMap& operator=(SnowflakeMap other) noexcept {
+            swap(other);
+            return *this;
+        }
+
+        ~SnowflakeMap() {
+            destroyAll();
+            deallocate();
+        }
+
+        void swap(SnowflakeMap& other) noexcept {
+            std::swap(ctrl,       other.ctrl);
+            std::swap(slots,      other.slots);
+            std::swap(capacity,   other.capacity);
+            std::swap(elements,   other.elements);
+            std::swap(growthLeft, other.growthLeft);
+        }
+
+        iterator begin() {
+            iterator it(ctrl, slots, ctrl + capacity);
+            it.skipFree();
+            return it;
+        }
+
+        const_iterator begin() const {
+            const_iterator it(ctrl, slots, ctrl + capacity);
+            it.skipFree();
+            return it;
+        }
+
+        iterator       end()       { return iterator(ctrl + capacity, slots + capacity, ctrl + capacity); }
+        const_iterator end() const { return const_iterator(ctrl + capacity, slots + capacity, ctrl + capacity); }
+
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend()   const { return end(); }
+
+        size_type size() const  { return elements; }
+        bool      empty() const { return elements == 0; }
+
+        iterator find(Snowflake key) {
+            size_t index = findIndex(key);
+            return index == capacity ? end() : iteratorAt(index);
+        }
+
+        const_iterator find(Snowflake key) const {
+            size_t index = findIndex(key);
+            return index == capacity ? end() : const_iterator(ctrl + index, slots + index, ctrl + capacity);
+        }
+
+        size_type count(Snowflake key) const {
+            return findIndex(key) != capacity ? 1 : 0;
+        }
+
+        T& at(Snowflake key) {
+            size_t index = findIndex(key);
+            if (index == capacity) throw std::out_of_range("SnowflakeMap::at");
+            return slots[index].second;
+        }
+
+        const T& at(Snowflake key) const {
+            size_t index = findIndex(key);
+            if (index == capacity) throw std::out_of_range("SnowflakeMap::at");
+            return slots[index].second;
+        }
+
+        T& operator[](Snowflake key) {
+            return emplace(key).first->second;
+        }
+
+        /**
+         * Construct value from args if key is not present.
+         */
+        template<typename... Args>
+        std::pair<iterator, bool> emplace(Snowflake key, Args&&... args) {
+            uint64_t hash = hashSnowflake(key);
+
+            size_t index = findIndex(key, hash);
+            if (index != capacity) return { iteratorAt(index), false };
+
+            index = prepareInsert(hash);
+            new (slots + index) value_type(std::piecewise_construct,
+                                           std::forward_as_tuple(key),
+                                           std::forward_as_tuple(std::forward<Args>(args)...));
+            ctrl[index] = h2(hash);
+            ++elements;
+            return { iteratorAt(index), true };
+        }
+
+        std::pair<iterator, bool> insert(const value_type& value) {
+            return emplace(value.first, value.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& value) {
+            return emplace(value.first, std::move(value.second));
+        }
+
+        size_type erase(Snowflake key) {
+            size_t index = findIndex(key);
+            if (index == capacity) return 0;
+            eraseAt(index);
+            return 1;
+        }
+
+        iterator erase(const_iterator pos) {
+            size_t index = size_t(pos.ctrl - ctrl);
+            eraseAt(index);
+
+            iterator next = iteratorAt(index);
+            next.skipFree();
+            return next;
+        }
+
+        void clear() {
+            destroyAll();
+            if (capacity != 0) std::memset(ctrl, _detail::ctrlEmpty, capacity);
+            elements = 0;
+            growthLeft = maxLoad(capacity);
+        }
+
+        /**
+         * Allocate enough space for count elements without rehashing.
+         */
+        void reserve(size_type count) {
+            size_t newCapacity = _detail::groupWidth;
+            while (maxLoad(newCapacity) < count) newCapacity *= 2;
+            if (newCapacity > capacity) resize(newCapacity);
+        }
+    private:
+        // Max load factor is 7/8.
+        static size_t maxLoad(size_t capacity) {
+            return capacity - capacity / 8;
+        }
+
+        // Upper bits select group, lower 7 bits are stored in control byte.
+        static size_t  h1(uint64_t hash) { return size_t(hash >> 7); }
+        static int8_t  h2(uint64_t hash) { return int8_t(hash & 0x7F); }
+
+        iterator iteratorAt(size_t index) {
+            return iterator(ctrl + index, slots + index, ctrl + capacity);
+        }
+
+        size_t findIndex(Snowflake key) const {
+            return findIndex(key, hashSnowflake(key));
+        }
+
+        // Index of slot with key or capacity if not found.
+        size_t findIndex(Snowflake key, uint64_t hash) const {
+            if (capacity == 0) return capacity;
+
+            size_t groupMask = capacity / _detail::groupWidth - 1;
+            size_t group = h1(hash) & groupMask;
+
+            // Triangular probing visits every group when their count is a power of two.
+            for (size_t step = 1; ; ++step) {
+                size_t base = group * _detail::groupWidth;
+                _detail::Group controls(ctrl + base);
+
+                for (uint32_t mask = controls.match(h2(hash)); mask != 0; mask &= mask - 1) {
+                    size_t index = base + _detail::countTrailingZeros(mask);
+                    if (slots[index].first == key) return index;
+                }
+                if (controls.matchEmpty() != 0) return capacity;
+
+                group = (group + step) & groupMask;
+            }
+        }
+
+        size_t findFreeIndex(uint64_t hash) const {
+            size_t groupMask = capacity / _detail::groupWidth - 1;
+            size_t group = h1(hash) & groupMask;
+
+            for (size_t step = 1; ; ++step) {
+                size_t base = group * _detail::groupWidth;
+                uint32_t mask = _detail::Group(ctrl + base).matchEmptyOrDeleted();
+                if (mask != 0) return base + _detail::countTrailingZeros(mask);
+
+                group = (group + step) & groupMask;
+            }
+        }
+
+        size_t prepareInsert(uint64_t hash) {
+            if (growthLeft == 0) {
+                if (capacity == 0) {
+                    resize(_detail::groupWidth);
+                } else if (elements * 2 <= maxLoad(capacity)) {
+                    resize(capacity); // Mostly tombstones, just clean them up.
+                } else {
+                    resize(capacity * 2);
+                }
+            }
+
+            size_t index = findFreeIndex(hash);
+            if (ctrl[index] == _detail::ctrlEmpty) --growthLeft;
+            return index;
+        }
+
+        void eraseAt(size_t index) {
+            slots[index].~value_type();
+            --elements;
+
+            // Probing stops at groups with empty slots, so if group of this slot
+            // already has one, no probe sequence continues past it and slot can
+            // become empty too. Otherwise it must be a tombstone.
+            size_t base = index - index % _detail::groupWidth;
+            if (_detail::Group(ctrl + base).matchEmpty() != 0) {
+                ctrl[index] = _detail::ctrlEmpty;
+                ++growthLeft;
+            } else {
+                ctrl[index] = _detail::ctrlDeleted;
+            }
+        }
+
+        void resize(size_t newCapacity) {
+            int8_t*     oldCtrl     = ctrl;
+            value_type* oldSlots    = slots;
+            size_t      oldCapacity = capacity;
+
+            std::unique_ptr<int8_t[]> newCtrl(new int8_t[newCapacity]);
+            slots = static_cast<value_type*>(::operator new(newCapacity * sizeof(value_type)));
+            ctrl  = newCtrl.release();
+            capacity = newCapacity;
+            std::memset(ctrl, _detail::ctrlEmpty, newCapacity);
+            growthLeft = maxLoad(newCapacity) - elements;
+
+            for (size_t i = 0; i < oldCapacity; ++i) {
+                if (oldCtrl[i] < 0) continue;
+
+                uint64_t hash = hashSnowflake(oldSlots[i].first);
+                size_t index = findFreeIndex(hash);
+                new (slots + index) value_type(std::move(oldSlots[i]));
+                ctrl[index] = h2(hash);
+                oldSlots[i].~value_type();
+            }
+
+            delete[] oldCtrl;
+            ::operator delete(oldSlots);
+        }
+
+        void destroyAll() {
+            for (size_t i = 0; i < capacity; ++i) {
+                if (ctrl[i] >= 0) slots[i].~value_type();
+            }
+        }
+
+        void deallocate() {
+            delete[] ctrl;
+            ::operator delete(slots);
+            ctrl = nullptr;
+            slots = nullptr;
+            capacity = 0;
+        }
+
+        int8_t*     ctrl       = nullptr;
+        value_type* slots      = nullptr;
+        size_t      capacity   = 0;     // Zero or power of two, not less than group width.
+        size_t      elements   = 0;
+        size_t      growthLeft = 0;     // Number of empty slots that can be filled before rehash.
+    };
+} // namespace Hexicord
+
+#endif // HEXICORD_SNOWFLAKE_MAP_HPP
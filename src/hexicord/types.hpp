@@ -1,3 +1,4 @@
 #include <hexicord/types/file.hpp>
 #include <hexicord/types/image.hpp>
+#include <hexicord/types/shared_buffer.hpp>
 #include <hexicord/types/snowflake.hpp>
@@ -1,35 +1,129 @@
 #include <hexicord/types/file.hpp>
 
-#include <iterator>                    // std::istreambuf_iterator
-#include <algorithm>                   // std::copy
 #include <fstream>                     // std::ifstream
+#include <cstring>                     // std::strerror
+#include <cerrno>                      // errno
+#include <memory>                      // std::make_shared
+#include <hexicord/exceptions.hpp>     // RuntimeError
 #include <hexicord/internal/utils.hpp> // Utils::split
 
 #if _WIN32
     #define PATH_DELIMITER '\\'
 #elif !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
     #define PATH_DELIMITER '/'
+    #define HAVE_MMAP 1
+
+    #include <fcntl.h>                 // open
+    #include <unistd.h>                // close
+    #include <sys/stat.h>              // fstat
+    #include <sys/mman.h>              // mmap, munmap, madvise
 #endif
 
 namespace Hexicord {
 
+namespace {
+    std::string filenameFromPath(const std::string& path) {
+        return Utils::split(path, PATH_DELIMITER).back();
+    }
+
+    // Read in large blocks, size is known in advance for seekable streams.
+    std::vector<uint8_t> readStream(std::istream& stream) {
+        std::vector<uint8_t> bytes;
+
+        std::istream::pos_type start = stream.tellg();
+        if (start != std::istream::pos_type(-1) && stream.seekg(0, std::ios_base::end)) {
+            std::istream::pos_type end = stream.tellg();
+            stream.seekg(start);
+            if (end != std::istream::pos_type(-1) && end > start) bytes.reserve(size_t(end - start));
+        }
+        stream.clear();
+
+        char chunk[64 * 1024];
+        while (stream.read(chunk, sizeof(chunk)) || stream.gcount() > 0) {
+            bytes.insert(bytes.end(), chunk, chunk + stream.gcount());
+        }
+        return bytes;
+    }
+
+#ifdef HAVE_MMAP
+    class Mapping {
+    public:
+        Mapping(void* address, size_t size) : address(address), size(size) {}
+        ~Mapping() { munmap(address, size); }
+
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+
+        void* const address;
+        const size_t size;
+    };
+
+    RuntimeError mappingError(const std::string& what, const std::string& path, int error) {
+        return RuntimeError(what + " " + path + ": " + std::strerror(error), error);
+    }
+#endif
+} // anonymous namespace
+
 File::File(const std::string& path)
-    : filename(Utils::split(path, PATH_DELIMITER).back())
-    , bytes(std::istreambuf_iterator<char>(std::ifstream(path, std::ios_base::binary).rdbuf()),
-            std::istreambuf_iterator<char>()) {}
+    : filename(filenameFromPath(path))
+    , bytes([&path]() {
+        std::ifstream stream(path, std::ios_base::binary);
+        return readStream(stream);
+    }()) {}
 
 File::File(const std::string& filename, std::istream&& stream)
     : filename(filename)
-    , bytes(std::istreambuf_iterator<char>(stream.rdbuf()),
-            std::istreambuf_iterator<char>()) {}
+    , bytes(readStream(stream)) {}
 
 File::File(const std::string& filename, const std::vector<uint8_t>& bytes)
     : filename(filename)
     , bytes(bytes) {}
 
+File::File(const std::string& filename, std::vector<uint8_t>&& bytes)
+    : filename(filename)
+    , bytes(std::move(bytes)) {}
+
+File::File(const std::string& filename, SharedBuffer bytes)
+    : filename(filename)
+    , bytes(std::move(bytes)) {}
+
+File File::map(const std::string& path) {
+#ifdef HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw mappingError("Failed to open", path, errno);
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        int error = errno;
+        ::close(fd);
+        throw mappingError("Failed to stat", path, error);
+    }
+
+    // Pipes, devices, etc can't be mapped (and mapping empty file fails).
+    if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+        ::close(fd);
+        return File(path);
+    }
+
+    size_t size = size_t(info.st_size);
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    ::close(fd); // mapping stays valid after descriptor is closed.
+    if (address == MAP_FAILED) throw mappingError("Failed to map", path, error);
+
+    // Uploads read file once from start to end.
+    madvise(address, size, MADV_SEQUENTIAL);
+
+    auto mapping = std::make_shared<Mapping>(address, size);
+    return File(filenameFromPath(path), SharedBuffer(mapping, static_cast<const uint8_t*>(address), size));
+#else
+    return File(path);
+#endif
+}
+
 void File::write(const std::string& targetPath) const {
     std::ofstream output(targetPath, std::ios_base::binary | std::ios_base::trunc);
-    std::copy(bytes.begin(), bytes.end(), std::ostreambuf_iterator<char>(output.rdbuf()));
+    output.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
 }
 
 } // namespace Hexicord
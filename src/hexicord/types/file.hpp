@@ -3,6 +3,8 @@
 
 #include <string>   // std::string
 #include <vector>   // std::vector
+#include <istream>  // std::istream
+#include <hexicord/types/shared_buffer.hpp>
 
 namespace Hexicord {
     /**
@@ -21,17 +23,47 @@ namespace Hexicord {
         File(const std::string& filename, std::istream&& stream);
 
         /**
-         * Use passed vector as file contents.
+         * Use copy of passed vector as file contents.
          */
         File(const std::string& filename, const std::vector<uint8_t>& bytes);
 
+        /**
+         * Use passed vector as file contents, without copying.
+         */
+        File(const std::string& filename, std::vector<uint8_t>&& bytes);
+
+        /**
+         * Share passed buffer as file contents.
+         */
+        File(const std::string& filename, SharedBuffer bytes);
+
+        /**
+         * Map file specified by `path` into memory (read-only) instead of
+         * reading it. Pages are loaded on demand as \ref bytes are accessed,
+         * so uploading large file doesn't require it to fit in memory.
+         * Mapping is released when last copy of \ref bytes is destroyed.
+         *
+         * Falls back to reading file if it's not a regular file or memory
+         * mapping is not supported on platform.
+         *
+         * \warning File should not be truncated while it's mapped, accessing
+         *          removed part of mapping crashes process (SIGBUS).
+         *
+         * \throws RuntimeError if file can't be opened or mapped.
+         */
+        static File map(const std::string& path);
+
         /**
          * Helper function, write file to std::ofstream(targetPath).
          */
         void write(const std::string& targetPath) const;
 
         const std::string filename;
-        const std::vector<uint8_t> bytes;
+        /**
+         * File contents. Shared by copies of File, \ref Image and request
+         * bodies built from it.
+         */
+        const SharedBuffer bytes;
     };
 } // namespace Hexicord
 
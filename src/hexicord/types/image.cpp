@@ -4,6 +4,7 @@
 #include <hexicord/internal/utils.hpp> // Utils::Magic, Utils::base64Encode
 #include <hexicord/exceptions.hpp>     // LogicError
 #include <hexicord/internal/rest.hpp>  // REST::HTTPSConnection
+#include <hexicord/cdn_client.hpp>     // CdnClient
 
 namespace Hexicord {
 
@@ -19,7 +20,10 @@ std::string Image::toAvatarData() const {
     if (format == Webp) mimeType = "image/webp";
     if (format == Gif)  mimeType = "image/gif";
 
-    return std::string("data:") + mimeType + ";base64," + Utils::base64Encode(file.bytes);
+    // Encoded directly after prefix, without temporary string.
+    std::string result = std::string("data:") + mimeType + ";base64,";
+    Utils::base64Encode(file.bytes, result);
+    return result;
 }
 
 ImageFormat Image::detectFormat(const File& file) {
@@ -51,6 +55,10 @@ namespace _detail {
 
         return response.body;
     }
+
+    SharedBuffer cdnDownload(CdnClient& cdn, const std::string& path) {
+        return cdn.download(path);
+    }
 } // namespace _detail
 
 } // namespace Hexicord
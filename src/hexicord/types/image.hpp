@@ -10,6 +10,7 @@
 namespace boost { namespace asio { class io_service; }}
 
 namespace Hexicord {
+    class CdnClient;
 
     /**
      * Image formats supported by API.
@@ -66,6 +67,7 @@ namespace Hexicord {
      */
     namespace _detail {
         std::vector<uint8_t> cdnDownload(boost::asio::io_service& ioService, const std::string& path);
+        SharedBuffer cdnDownload(CdnClient& cdn, const std::string& path);
 
         inline constexpr bool isPowerOfTwo(unsigned number) {
             return ((number != 0) && ((number & (~number + 1)) == number));
@@ -151,6 +153,20 @@ namespace Hexicord {
                          Format);
         }
 
+        /**
+         * Same as above, but uses pooled connections and cache of CdnClient.
+         * Prefer it when downloading many images.
+         */
+        template<ImageFormat Format>
+        inline Image download(CdnClient& cdn, unsigned short size) const {
+            static_assert(_detail::isSupportedFormat(Type, Format), "Format is not supported for this image type.");
+            if (!_detail::isPowerOfTwo(size)) throw LogicError("Image size must be power of two.", -1);
+
+            return Image(File(hash + "." + _detail::formatExtension<Format>(),
+                              _detail::cdnDownload(cdn, url<Format>(size))),
+                         Format);
+        }
+
         const Snowflake id;
         const std::string hash;
     };
@@ -208,6 +224,17 @@ namespace Hexicord {
                          Format);
         }
 
+        /**
+         * Same as above, but uses pooled connections and cache of CdnClient.
+         * Prefer it when downloading many images.
+         */
+        template<ImageFormat Format>
+        inline Image download(CdnClient& cdn, unsigned short size) const {
+            return Image(File(hash + "." + _detail::formatExtension<Format>(),
+                              _detail::cdnDownload(cdn, url<Format>(size))),
+                         Format);
+        }
+
         const std::string hash;
     };
    
@@ -263,6 +290,20 @@ namespace Hexicord {
                          Format);
         }
 
+        /**
+         * Same as above, but uses pooled connections and cache of CdnClient.
+         * Prefer it when downloading many images.
+         */
+        template<ImageFormat Format>
+        inline Image download(CdnClient& cdn, unsigned short size) const {
+            static_assert(_detail::isSupportedFormat(DefaultUserAvatar, Format), "Format is not supported for this image type.");
+            if (!_detail::isPowerOfTwo(size)) throw LogicError("Image size must be power of two.", -1);
+
+            return Image(File(std::to_string(userDiscriminator % 5) + "." + _detail::formatExtension<Format>(),
+                              _detail::cdnDownload(cdn, url<Format>(size))),
+                         Format);
+        }
+
         const int userDiscriminator;
     };
 
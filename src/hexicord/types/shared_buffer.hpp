@@ -0,0 +1,82 @@
+#ifndef HEXICORD_TYPES_SHARED_BUFFER_HPP
+#define HEXICORD_TYPES_SHARED_BUFFER_HPP
+
+#include <cstdint>  // uint8_t
+#include <cstddef>  // size_t
+#include <memory>   // std::shared_ptr, std::make_shared
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+namespace Hexicord {
+    /**
+     * Immutable reference-counted byte buffer.
+     *
+     * Copies share same storage, so file contents can be passed from
+     * \ref File to request body without copying bytes. Storage can be owned
+     * by any object (vector, string, memory mapping), it's freed when last
+     * copy of buffer is destroyed.
+     */
+    class SharedBuffer {
+    public:
+        /**
+         * Construct empty buffer.
+         */
+        SharedBuffer() {}
+
+        /**
+         * Take ownership of vector contents, no bytes are copied.
+         */
+        SharedBuffer(std::vector<uint8_t>&& bytes) {
+            auto storage = std::make_shared<const std::vector<uint8_t> >(std::move(bytes));
+            pointer = storage->data();
+            length  = storage->size();
+            owner   = std::move(storage);
+        }
+
+        /**
+         * Copy vector contents. Explicit, so copies are visible.
+         */
+        explicit SharedBuffer(const std::vector<uint8_t>& bytes)
+            : SharedBuffer(std::vector<uint8_t>(bytes)) {}
+
+        /**
+         * Take ownership of string contents, no bytes are copied.
+         */
+        explicit SharedBuffer(std::string&& bytes) {
+            auto storage = std::make_shared<const std::string>(std::move(bytes));
+            pointer = reinterpret_cast<const uint8_t*>(storage->data());
+            length  = storage->size();
+            owner   = std::move(storage);
+        }
+
+        /**
+         * Reference size bytes at data, kept valid by owner.
+         */
+        SharedBuffer(std::shared_ptr<const void> owner, const uint8_t* data, size_t size)
+            : owner(std::move(owner))
+            , pointer(data)
+            , length(size) {}
+
+        inline const uint8_t* data()  const { return pointer;          }
+        inline size_t         size()  const { return length;           }
+        inline bool           empty() const { return length == 0;      }
+
+        inline const uint8_t* begin() const { return pointer;          }
+        inline const uint8_t* end()   const { return pointer + length; }
+
+        inline uint8_t operator[](size_t index) const { return pointer[index]; }
+
+        /**
+         * Copy contents to new vector.
+         */
+        inline std::vector<uint8_t> toVector() const {
+            return std::vector<uint8_t>(begin(), end());
+        }
+    private:
+        std::shared_ptr<const void> owner;
+        const uint8_t* pointer = nullptr;
+        size_t length = 0;
+    };
+} // namespace Hexicord
+
+#endif // HEXICORD_TYPES_SHARED_BUFFER_HPP
@@ -38,6 +38,20 @@ namespace Hexicord {
         inline constexpr operator uint64_t() const { return value; }
     };
 
+    /**
+     * Hash for snowflakes. Raw value is a bad hash: low bits are counter and
+     * worker/process IDs, so most of IDs fall into few buckets when table
+     * size is a power of two. Bits are mixed using MurmurHash3 finalizer.
+     */
+    inline uint64_t hashSnowflake(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
     inline void to_json(nlohmann::json& json, const Snowflake& snowflake) {
         json = uint64_t(snowflake);
     }
@@ -51,8 +65,8 @@ namespace std {
     template<>
     class hash<Hexicord::Snowflake> {
     public:
-        constexpr inline size_t operator()(const Hexicord::Snowflake& snowflake) const {
-            return static_cast<uint64_t>(snowflake);
+        inline size_t operator()(const Hexicord::Snowflake& snowflake) const {
+            return static_cast<size_t>(Hexicord::hashSnowflake(snowflake));
         }
     };
 }